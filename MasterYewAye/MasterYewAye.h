@@ -25,7 +25,7 @@ struct Pin {
     static const uint8_t owbMosfet = 13;
     static const uint8_t arfMosfet = A3;
 
-    // One-wire bus
+    // One-wire bus, both on PORTB for OwbPort
     static const uint8_t owbA = 11;
     static const uint8_t owbB = 10;
 
@@ -66,6 +66,7 @@ struct PowerSense {
 
 struct OwbStatus {
     static const uint8_t converting = 1;
+    static const uint8_t addressed = 2;
     static const uint8_t notFound = 3;
     static const uint8_t romBadCrc = 4;
     static const uint8_t ramBadCrc = 5;
@@ -77,37 +78,18 @@ struct OwbStatus {
 
 struct EncState {
     static const uint8_t current = 0;
-    static const uint8_t one = 1;
-    static const uint8_t four = 2;
-    static const uint8_t twelve = 3;
-    static const uint8_t battery = 4;
+    static const uint8_t hour = 1;
+    static const uint8_t day = 2;
+    static const uint8_t dayLow = 3;
+    static const uint8_t dayHigh = 4;
+    static const uint8_t week = 5;
+    static const uint8_t weekLow = 6;
+    static const uint8_t weekHigh = 7;
+    static const uint8_t battery = 8;
 };
 
-typedef struct Owb {
-    static const int16_t checkStatus = -850;
-    OneWire bus;
-    uint8_t status;
-    int16_t x10degrees;
-    SimpleMovingAvg oneHour;
-    SimpleMovingAvg fourHour;
-    SimpleMovingAvg twelveHour;
-    Owb(uint8_t pin, uint16_t onePoints, uint16_t fourPoints, uint16_t twelvePoints)
-        : bus(pin), status(OwbStatus::none), x10degrees(checkStatus),
-          oneHour(onePoints), fourHour(fourPoints), twelveHour(twelvePoints) {};
-} Owb;
-
-typedef struct Sma {
-    Owb owbA;
-    Owb owbB;
-    Sma(uint8_t pinA, uint8_t pinB,
-        uint16_t onePointsA, uint16_t onePointsB,
-        uint16_t fourPointsA, uint16_t fourPointsB,
-        uint16_t twelvePointsA, uint16_t twelvePointsB)
-        : owbA(pinA, onePointsA, fourPointsA, twelvePointsA),
-          owbB(pinB, onePointsB, fourPointsB, twelvePointsB) {};
-} Sma;
-
 static const uint16_t wdtSleep8 = 7806UL; // 8 sec avg WDT osc time
+static const uint8_t wdtPeriod8 = 9; // WDP3:0 for "8 seconds", 16ms << 9
 static const Millis lcdTime = 500UL; // < 1000ms is unreadable
 static const Millis wakeTime = 100UL;  // update wake counter
 static const Millis encTime = 1UL;
@@ -115,31 +97,81 @@ static const Millis encTime = 1UL;
     static const uint8_t sleepCycleMultiplier = 1;
     static const Millis batterySample = 270000UL; // 4.5 minutes (in ms)
     static const Millis tempSmaSample = 60000UL; // 1 minute (in ms)
-    static const Millis tempSmaOne = 360000UL; // 6 minutes SMA
-    static const Millis tempSmaFour = 1440000UL; // 24 minute SMA
-    static const Millis tempSmaTwelve = 4320000UL;  // 1.2 hour SMA
+    static const Millis tempSmaHour = 360000UL; // 6 minute "hours"
+    static const Millis tempSmaDay = 8640000UL;  // 2.4 hour "days"
 #else
     static const uint8_t sleepCycleMultiplier = 8;
     static const Millis batterySample = 2700000UL; // 45 minutes (in ms)
     static const Millis tempSmaSample = 600000UL; // 10 minutes (in ms)
-    static const Millis tempSmaOne = 3600000UL; // 1 hour SMA
-    static const Millis tempSmaFour = 14400000UL; // 4 hour SMA
-    static const Millis tempSmaTwelve = 43200000UL;  // 12 hours SMA
+    static const Millis tempSmaHour = 3600000UL; // 1 hour buckets
+    static const Millis tempSmaDay = 86400000UL;  // 1 day buckets
 #endif // DEBUG
+static const uint8_t tempHistHours = 24; // hourly buckets kept
+static const uint8_t tempHistDays = 7; // daily buckets kept
 static const uint8_t lcdRows = 2;
 static const uint8_t lcdCols = 16;
 static const bool celsius = false;
+static const uint8_t tempResolutionLive = 10; // DS18B20 bits, 188ms
+static const uint8_t tempResolutionSma = 12; // 750ms
+static const Millis tempConvertMax = 750UL; // DS18S20 at any resolution
 static const int8_t wakeMinMultiplier = 10; // 1 sec
 static const int16_t wakeMaxMultiplier = 300; // 30 sec
 
+static const uint8_t owbSensors = 2; // DS18x20s kept per bus, ~220B RAM each
+
+typedef struct OwbTable {
+    uint8_t count; // slots in use, the last one holds a ROM
+    bool single; // only device on the bus, Skip ROM addresses it
+    uint8_t rom[owbSensors][8]; // family, serial, crc8, all 0 when empty
+} OwbTable;
+
+typedef struct Sensor {
+    static const int16_t checkStatus = -850;
+    uint8_t status;
+    int16_t x10degrees;
+    TempHistory<tempSmaHour / tempSmaSample, tempHistHours,
+                tempSmaDay / tempSmaHour, tempHistDays> history;
+    Sensor() : status(OwbStatus::none), x10degrees(checkStatus) {};
+    void reset(void) {  // a different DS18x20 took the slot
+        status = OwbStatus::none;
+        x10degrees = checkStatus;
+        history.clear();
+    }
+} Sensor;
+
+typedef struct Owb {
+    OneWire bus; // searches, owbAsync does the rest
+    uint8_t mask; // owbPort bit
+    OwbTable roms;
+    OwbTable* romStore; // EEPROM copy, tried before searching after boot
+    bool romCached; // roms is good to use
+    bool romSearch; // roms or romStore failed, search the bus again
+    uint8_t found; // bit per roms slot that answered the last search
+    uint8_t status; // converting, or why the bus isn't
+    uint8_t resolution; // bits in the scratchpad configs, 0 if unknown
+    Sensor sensor[owbSensors]; // same order as roms
+    Owb(uint8_t pin, OwbTable* store)
+        : bus(pin), mask(PIN_TO_BITMASK(pin)), romStore(store),
+          romCached(false), romSearch(false), found(0),
+          status(OwbStatus::none), resolution(0) {};
+} Owb;
+
+typedef struct Sma {
+    Owb owbA;
+    Owb owbB;
+    Sma(uint8_t pinA, uint8_t pinB, OwbTable* romStoreA, OwbTable* romStoreB)
+        : owbA(pinA, romStoreA), owbB(pinB, romStoreB) {};
+} Sma;
+
 // globals
 
-uint16_t encMinMax = 4; // MSB: Min; LSB: Max
-uint8_t encValue = EncState::current;
+uint8_t encValue = EncState::current; // view * sensor_pages() + page
 bool lcdDisplay = false;
 bool lcdRefresh = true;
 int16_t wakeCounter = wakeMinMultiplier; // stay awake until 0
 volatile Millis sleepCycleCounter = 0;
+volatile bool wdtShort = false; // WDT isn't on its 8 sec period
+Millis convertSleep = 0; // ms slept through conversions, see update_time()
 
 LiquidCrystal lcd(Pin::lcdRS, Pin::lcdEN, Pin::lcdD4,
                   Pin::lcdD5, Pin::lcdD6, Pin::lcdD7);
@@ -148,12 +180,16 @@ Encoder enc(Pin::encA, Pin::encC);
 
 Button button(Pin::button, BUTTON_PULLUP);
 
-Sma sma(Pin::owbA, Pin::owbB,
-        tempSmaOne / tempSmaSample, tempSmaOne / tempSmaSample,
-        tempSmaFour / tempSmaSample, tempSmaFour / tempSmaSample,
-        tempSmaTwelve / tempSmaOne, tempSmaTwelve / tempSmaOne);
+OwbPort owbPort(Pin::owbA);
+OwbAsync owbAsync(Pin::owbA);
+
+OwbTable owbRomStore[2] EEMEM;
+
+Sma sma(Pin::owbA, Pin::owbB, &owbRomStore[0], &owbRomStore[1]);
 
 Millis currentTime = 0;
+Millis convertStart = 0; // millis() both buses were told to convert
+Millis convertMs = 0; // how long that conversion takes, see conversion_ms()
 
 unsigned int battMvPrev = 0;
 unsigned int battMv = 0;
@@ -1,93 +1,182 @@
 #include <avr/sleep.h>
 #include <avr/power.h>
 #include <avr/wdt.h>
+#include <avr/eeprom.h>
 #include <stdlib.h>
 #include <Arduino.h>
 #include <Button.h>
 #include <Encoder.h>
 #include <LiquidCrystal.h>
 #include <OneWire.h>
-#include <MovingAvg.h>
+#include "TempHistory.h"
 #include <TimedEvent.h>
+#include "OwbPort.h"
+#include "OwbAsync.h"
 #include "MasterYewAye.h"
 
 ISR(WDT_vect) {
-    sleepCycleCounter++;
-}
-
-// Start conversion on first device found
-uint8_t start_conversion(OneWire& owb) {
-    //D(F("Start conversion..."));
-    owb.reset_search();
-    uint8_t buff[8];
-    uint8_t present = 0;
-    present = owb.search(buff);
-    if (!present)
-        return OwbStatus::notFound;
-    if (OneWire::crc8(buff, 7) != buff[7])
-        return OwbStatus::romBadCrc;
-    present = owb.reset();  // prepare for next command
-    if (present == 0)
-        return OwbStatus::busError;
-    if ((buff[0] != 0x10) && (buff[0] != 0x28) && (buff[0] != 0x22))
-        return OwbStatus::notDs18x20;
-    owb.select(buff);
-    owb.write(0x44, 1); // Start conversion
-    return OwbStatus::converting;
-}
-
-inline bool conversion_done(OneWire& owb) {
-    if (owb.read_bit() == 1)
-        return true;
-    else
+    if (!wdtShort)
+        sleepCycleCounter++;
+}
+
+// WDT interrupt period, 16ms << wdp nominal
+void wdt_period(uint8_t wdp) {
+    uint8_t bits = _BV(WDIE) | (wdp & 7);
+    if (wdp & 8)
+        bits |= _BV(WDP3);
+    cli();
+    wdt_reset();
+    WDTCSR |= (1<<WDCE) | (1<<WDE);  // 4 cycles to change it
+    WDTCSR = bits;
+    wdtShort = (wdp != wdtPeriod8);
+    sei();
+}
+
+// Actual ms of a WDT period, scaled like wdtSleep8
+inline Millis wdt_ms(uint8_t wdp) {
+    return (16UL << wdp) * wdtSleep8 / 8192;
+}
+
+inline bool is_ds18x20(const uint8_t* rom) {
+    return (rom[0] == 0x10) || (rom[0] == 0x28) || (rom[0] == 0x22);
+}
+
+// Next access searches the bus again
+void owb_forget(Owb& owb) {
+    owb.romCached = false;
+    owb.romSearch = true;
+}
+
+// Bit per slot holding a ROM
+uint8_t owb_used(const OwbTable& table) {
+    uint8_t used = 0;
+    for (uint8_t i = 0; i < table.count; i++)
+        if (is_ds18x20(table.rom[i]))
+            used |= 1 << i;
+    return used;
+}
+
+// Search again next access while a known sensor is missing
+void owb_recheck(Owb& owb) {
+    if (owb.romCached && owb.found != owb_used(owb.roms))
+        owb_forget(owb);
+}
+
+// Every slot in use holds a DS18x20 with a good CRC or is empty
+bool owb_table_ok(const OwbTable& table) {
+    if (table.count == 0 || table.count > owbSensors ||
+        !is_ds18x20(table.rom[table.count - 1]))
         return false;
+    for (uint8_t i = 0; i < table.count; i++)
+        if (is_ds18x20(table.rom[i])
+                ? (OneWire::crc8(table.rom[i], 7) != table.rom[i][7])
+                : (table.rom[i][0] != 0))
+            return false;
+    return true;
+}
+
+// Slot holding rom, owbSensors if none does
+uint8_t owb_slot(const OwbTable& table, const uint8_t* rom) {
+    for (uint8_t i = 0; i < table.count; i++)
+        if (memcmp(table.rom[i], rom, 8) == 0)
+            return i;
+    return owbSensors;
+}
+
+// Slot for a new ROM: an empty one, else one whose ROM didn't answer
+uint8_t owb_free_slot(const OwbTable& table, uint8_t found) {
+    for (uint8_t i = 0; i < owbSensors; i++)
+        if (i >= table.count || !is_ds18x20(table.rom[i]))
+            return i;
+    for (uint8_t i = 0; i < owbSensors; i++)
+        if (!(found & (1 << i)))
+            return i;
+    return owbSensors;
+}
+
+// Enumerate the bus, remember its DS18x20s in RAM and EEPROM.  Known ROMs
+// keep their slots, and with them their sensor's history, a missing one
+// keeps its slot until a new ROM needs it.  A failed search changes nothing.
+uint8_t owb_search(Owb& owb) {
+    uint8_t rom[8];
+    uint8_t fresh[owbSensors][8];  // ROMs not in the table yet
+    uint8_t freshCount = 0;
+    uint8_t found = 0;
+    uint8_t devices = 0;
+    uint8_t status = OwbStatus::notFound;
+
+    DL(F("OWB ROM search"));
+    if (!owb_table_ok(owb.roms))
+        memset(&owb.roms, 0, sizeof(OwbTable));  // nothing worth keeping
+    owb.bus.reset_search();
+    while (owb.bus.search(rom)) {
+        devices++;
+        if (OneWire::crc8(rom, 7) != rom[7])
+            return OwbStatus::romBadCrc;  // search went wrong, next time
+        if (!is_ds18x20(rom)) {
+            status = OwbStatus::notDs18x20;
+            continue;
+        }
+        uint8_t slot = owb_slot(owb.roms, rom);
+        if (slot < owbSensors)
+            found |= 1 << slot;
+        else if (freshCount < owbSensors)
+            memcpy(fresh[freshCount++], rom, 8);
+    }
+    for (uint8_t i = 0; i < freshCount; i++) {
+        uint8_t slot = owb_free_slot(owb.roms, found);
+        if (slot >= owbSensors) {
+            DL(F("More DS18x20s than owbSensors, ignored"));
+            break;
+        }
+        D(F("New DS18x20 in slot ")); DL(slot);
+        memcpy(owb.roms.rom[slot], fresh[i], 8);
+        owb.sensor[slot].reset();  // history was another sensor's
+        found |= 1 << slot;
+        if (slot >= owb.roms.count)
+            owb.roms.count = slot + 1;
+    }
+    if (!found)
+        return status;
+    owb.found = found;
+    owb.roms.single = (devices == 1);
+    eeprom_update_block(&owb.roms, owb.romStore, sizeof(OwbTable));
+    owb.romSearch = false;
+    return OwbStatus::addressed;
+}
+
+// Make sure owb.roms is good, searching only if needed
+uint8_t owb_rom(Owb& owb) {
+    if (!owb.romCached) {
+        uint8_t status = OwbStatus::addressed;
+        if (!owb.romSearch) {  // after boot, try the last ROMs found
+            eeprom_read_block(&owb.roms, owb.romStore, sizeof(OwbTable));
+            owb.found = owb_used(owb.roms);
+        }
+        if (owb.romSearch || !owb_table_ok(owb.roms))
+            status = owb_search(owb);
+        if (status != OwbStatus::addressed) {
+            owb_forget(owb);
+            return status;
+        }
+        owb.romCached = true;
+    }
+    return OwbStatus::addressed;
 }
 
-// retrieve temperature on first device found
-uint8_t get_temp(OneWire& owb, int16_t& x10degrees, bool celsius) {
-    x10degrees = Owb::checkStatus;
+// retrieve temperature from a device's scratchpad, index in owb.roms
+uint8_t get_temp(Owb& owb, uint8_t index, uint8_t* ramBuff,
+                 int16_t& x10degrees, bool celsius) {
+    x10degrees = Sensor::checkStatus;
     //DL(F("Reading temperature"));
-    owb.reset_search();
-    uint8_t romBuff[8] = {0};
-    uint8_t ramBuff[9] = {0};
-    uint8_t present = owb.search(romBuff);
-    //D(1);
-    if (!present)
-        return OwbStatus::notFound;
-    //D(2);
-    if (OneWire::crc8(romBuff, 7) != romBuff[7])
-        return OwbStatus::romBadCrc;
-    present = owb.reset();  // prepare for next command
-    //D(3);
-    if (present == 0)
-        return OwbStatus::busError;
-    //D(4);
-    bool type_s = false;
-    if (romBuff[0] == 0x10)
-        type_s = true;
-    else if ((romBuff[0] == 0x28) || (romBuff[0] == 0x22))
-        type_s = false;
-    else
-        return OwbStatus::notDs18x20;
-    //D(5);
-    owb.select(romBuff);
-    owb.write(0xBE, 1);    // Read Scratchpad
-    owb.read_bytes(ramBuff, 9);
-    if (OneWire::crc8(ramBuff, 8) != ramBuff[8])
+    bool type_s = (owb.roms.rom[index][0] == 0x10);
+    if (OneWire::crc8(ramBuff, 8) != ramBuff[8]) {
+        owb_forget(owb);  // maybe not the device the ROM belongs to
         return OwbStatus::ramBadCrc;
-    // If resolution < 12, set it and go back to converting while EEProm updates
-    if (!type_s and (((ramBuff[4] & 0x60) >> 5) + 9) != 12) {
-        DL("Setting up 12-bit resolution");
-        ramBuff[2] = 0; ramBuff[3] = 0; ramBuff[4] = (12 - 9) << 5;
-        owb.reset();
-        owb.select(romBuff);
-        owb.write(0x4E, 1);  // write scratchpad
-        owb.write_bytes(ramBuff, 3);
-        owb.reset();
-        owb.select(romBuff);
-        owb.write(0x48);  // save to EEProm
-        return OwbStatus::converting;
     }
+    // if it's not what was asked for, the next start fixes it
+    if (!type_s && (((ramBuff[4] & 0x60) >> 5) + 9) != owb.resolution)
+        owb.resolution = 0;
     //D(6);
     x10degrees = (ramBuff[1] << 8) | ramBuff[0];
     if (type_s) {
@@ -122,6 +211,14 @@ void owb_power(bool on=true) {
         pinMode(Pin::owbA, INPUT);
         pinMode(Pin::owbB, INPUT);
         alreadyOn = false;
+        // configs go back to what's in the sensors' EEPROM
+        sma.owbA.resolution = 0;
+        sma.owbB.resolution = 0;
+        // conversions don't survive, the scratchpads reset to 85C
+        if (sma.owbA.status == OwbStatus::converting)
+            sma.owbA.status = OwbStatus::none;
+        if (sma.owbB.status == OwbStatus::converting)
+            sma.owbB.status = OwbStatus::none;
     } else if (!alreadyOn) {  // turning on twice can cause problms
         DL("OWB power up");
         pinMode(Pin::owbA, INPUT); // external pull-up
@@ -240,10 +337,7 @@ void enc_power(bool on=true) {
                 D(F("    Encoder A/C: ")); D(Pin::encA);
                 D(F(" / ")); DL(Pin::encC);
                 D(F("    Button: ")); DL(Pin::button);
-                D(F("Data size: ")); DL(sizeof(sma) +
-                                        ((tempSmaOne / tempSmaSample) * 4) +
-                                        ((tempSmaFour / tempSmaSample) * 4) +
-                                        ((tempSmaTwelve / tempSmaOne * 4)));
+                D(F("Data size: ")); DL(sizeof(sma));  // no heap
                 DL();
                 Serial.flush();
             }
@@ -308,51 +402,230 @@ void update_time(void) {
         }
         offset = sleepCycleCounter * wdtSleep8;
     }
-    currentTime = millis() + offset;
+    currentTime = millis() + offset + convertSleep;
 }
 
-void updateTemps(void) {
+// Old readings gone, e.g. after sleeping
+void owb_zap(Owb& owb) {
+    owb.status = OwbStatus::none;
+    for (uint8_t i = 0; i < owbSensors; i++) {
+        owb.sensor[i].status = OwbStatus::none;
+        owb.sensor[i].x10degrees = Sensor::checkStatus;
+    }
+}
+
+// Nothing read from the bus, none of its sensors have a temperature
+void owb_failed(Owb& owb, uint8_t status) {
+    owb_forget(owb);
+    owb.status = status;
+    for (uint8_t i = 0; i < owbSensors; i++) {
+        owb.sensor[i].status = status;
+        owb.sensor[i].x10degrees = Sensor::checkStatus;
+    }
+}
+
+void owb_started(Owb& owb, uint8_t present) {
+    if (present & owb.mask)
+        owb.status = OwbStatus::converting;
+    else
+        owb_failed(owb, OwbStatus::busError);
+}
+
+// Queue job and idle until Timer1 has run it, return the buses present
+uint8_t owb_run(OwbJob& job) {
+    owb_queue(job);  // never busy, every job is run to the end
+    set_sleep_mode(SLEEP_MODE_IDLE);  // Timer1, Timer0 and INT0/1 keep going
+    while (!job.done)
+        sleep_mode();
+    return job.present;
+}
+
+void owb_job_tx(OwbJob& job, Owb& owb, const uint8_t* tx, uint8_t len) {
+    job.mask |= owb.mask;
+    job.tx[OwbPort::bitnum(owb.mask)] = tx;
+    job.txLen[OwbPort::bitnum(owb.mask)] = len;
+}
+
+// DS18B20 worst case for bits, rounded up
+inline Millis conversion_ms(uint8_t bits) {
+    return (750UL + (1 << (12 - bits)) - 1) >> (12 - bits);
+}
+
+// Scratchpad config only, writing the sensors' EEPROM would wear it out
+void set_resolution(uint8_t bits) {
+    // Skip ROM, Write Scratchpad, TH, TL (no alarms), config
+    const uint8_t config[5] = {0xCC, 0x4E, 0, 0, (uint8_t)((bits - 9) << 5)};
+    OwbJob job = {0};
+
+    if (sma.owbA.resolution != bits)
+        owb_job_tx(job, sma.owbA, config, sizeof(config));
+    if (sma.owbB.resolution != bits)
+        owb_job_tx(job, sma.owbB, config, sizeof(config));
+    if (!job.mask)
+        return;
+    DL(F("Setting up resolution"));
+    uint8_t present = owb_run(job);
+    if (present & sma.owbA.mask)
+        sma.owbA.resolution = bits;
+    if (present & sma.owbB.mask)
+        sma.owbB.resolution = bits;
+}
+
+// Both buses convert at the same time, waiting is max(bus) not sum(bus)
+void start_conversions(uint8_t bits) {
+    static const uint8_t convert[2] = {0xCC, 0x44};  // Skip ROM, Convert T
+    OwbJob job = {0};
+
     owb_power(true);
-    if (sma.owbA.status == OwbStatus::converting &&
-        conversion_done(sma.owbA.bus)) {
+    set_resolution(bits);
+    owb_job_tx(job, sma.owbA, convert, sizeof(convert));
+    owb_job_tx(job, sma.owbB, convert, sizeof(convert));
+    job.power = true;  // for parasite powered devices
+    uint8_t present = owb_run(job);
+    owb_started(sma.owbA, present);
+    owb_started(sma.owbB, present);
+    convertStart = millis();
+    convertMs = conversion_ms(bits);
+}
+
+// owbPort mask of the buses converting
+uint8_t converting(void) {
+    uint8_t mask = 0;
+    if (sma.owbA.status == OwbStatus::converting)
+        mask |= sma.owbA.mask;
+    if (sma.owbB.status == OwbStatus::converting)
+        mask |= sma.owbB.mask;
+    return mask;
+}
+
+// Every bus that was converting has finished
+bool conversions_done(void) {
+    uint8_t mask = converting();
+    return owbPort.read_bit(mask) == mask;
+}
+
+// Line up a sensor's scratchpad read in job, return the bus's mask if wanted
+uint8_t read_prepare(Owb& owb, uint8_t index, uint8_t* tx, uint8_t* ramBuff,
+                     OwbJob& job) {
+    uint8_t bit = OwbPort::bitnum(owb.mask);
+    uint8_t len = 0;
+
+    if (owb.status != OwbStatus::converting)
+        return 0;
+    uint8_t status = owb_rom(owb);
+    if (status != OwbStatus::addressed) {
+        owb_failed(owb, status);
+        return 0;
+    }
+    if (!(owb.found & (1 << index))) {  // empty, or missed the last search
+        owb.sensor[index].status = OwbStatus::none;
+        owb.sensor[index].x10degrees = Sensor::checkStatus;
+        return 0;
+    }
+    if (owb.roms.single)
+        tx[len++] = 0xCC;  // Skip ROM
+    else {
+        tx[len++] = 0x55;  // Match ROM
+        memcpy(tx + len, owb.roms.rom[index], 8);
+        len += 8;
+    }
+    tx[len++] = 0xBE;  // Read Scratchpad
+    job.tx[bit] = tx;
+    job.txLen[bit] = len;
+    job.rx[bit] = ramBuff;
+    return owb.mask;
+}
+
+void read_finish(Owb& owb, uint8_t index, uint8_t* ramBuff,
+                 uint8_t wanted, uint8_t present) {
+    Sensor& sensor = owb.sensor[index];
+
+    if (!(wanted & owb.mask))
+        return;
+    if (present & owb.mask)
+        sensor.status = get_temp(owb, index, ramBuff,
+                                 sensor.x10degrees, celsius);
+    else
+        owb_failed(owb, OwbStatus::busError);
+}
+
+// Read every converting bus's sensors, one from each bus in lock-step
+void read_temps(void) {
+    owb_recheck(sma.owbA);
+    owb_recheck(sma.owbB);
+    for (uint8_t index = 0; index < owbSensors; index++) {
+        uint8_t txA[10], txB[10];
+        uint8_t ramA[9] = {0};
+        uint8_t ramB[9] = {0};
+        OwbJob job = {0};
+        job.mask = read_prepare(sma.owbA, index, txA, ramA, job) |
+                   read_prepare(sma.owbB, index, txB, ramB, job);
+        uint8_t wanted = job.mask;
+        if (!wanted)
+            continue;
+        job.rxLen = sizeof(ramA);
+        uint8_t present = owb_run(job);
+        read_finish(sma.owbA, index, ramA, wanted, present);
+        read_finish(sma.owbB, index, ramB, wanted, present);
+    }
+    if (sma.owbA.status == OwbStatus::converting)
         sma.owbA.status = OwbStatus::complete;
-        sma.owbA.status = get_temp(sma.owbA.bus,
-                                   sma.owbA.x10degrees, celsius);
-        sma.owbA.status = start_conversion(sma.owbA.bus);
-    } else
-        sma.owbA.status = start_conversion(sma.owbA.bus);
-    if (sma.owbB.status == OwbStatus::converting &&
-        conversion_done(sma.owbB.bus)) {
+    if (sma.owbB.status == OwbStatus::converting)
         sma.owbB.status = OwbStatus::complete;
-        sma.owbB.status = get_temp(sma.owbB.bus,
-                                   sma.owbB.x10degrees, celsius);
-        sma.owbB.status = start_conversion(sma.owbB.bus);
-    } else
-        sma.owbB.status = start_conversion(sma.owbB.bus);
 }
 
-void wait_conversion(void) {
-    updateTemps();  // power on, start conversion
-    DL(F("Waiting on A"));
-    while (sma.owbA.status == OwbStatus::converting)
-        if (conversion_done(sma.owbA.bus))
-            break;
-    DL(F("Waiting on B"));
-    while (sma.owbB.status == OwbStatus::converting)
-        if (conversion_done(sma.owbB.bus))
+// Live readings at tempResolutionLive, read once the conversion's done.
+// DS18S20s take tempConvertMax at any resolution, so ask the buses.
+void updateTemps(void) {
+    if (converting()) {
+        Millis elapsed = millis() - convertStart;
+        if (elapsed < convertMs)
+            return;  // restarting would throw it away
+        if (elapsed < tempConvertMax && !conversions_done())
+            return;  // one read slot, try again next time
+    }
+    read_temps();
+    start_conversions(tempResolutionLive);
+}
+
+// Power down for at least ms, in the longest WDT periods that fit
+void sleep_for(Millis ms) {
+    uint8_t wdp = wdtPeriod8;
+
+    set_sleep_mode(SLEEP_MODE_PWR_DOWN);  // pins, and bus power, stay put
+    while (ms > 0) {
+        while (wdp > 0 && wdt_ms(wdp) > ms)
+            wdp--;
+        if (wdt_ms(wdp) > ms) {  // less than the shortest period left
+            delay(ms);
             break;
-    updateTemps(); // Grab actual readings
-    owb_power(false); // no need to stay on
+        }
+        wdt_period(wdp);
+        cli();
+        sleep_enable();
+        sleep_bod_disable();
+        sei();
+        sleep_cpu(); // ZZzzzzzzzz
+        sleep_disable();
+        ms -= wdt_ms(wdp);
+        convertSleep += wdt_ms(wdp);  // millis() didn't see it
+    }
+    if (wdtShort)
+        wdt_period(wdtPeriod8);
 }
 
-uint16_t sma_append(SimpleMovingAvg& sma, int16_t x10degrees) {
-    if (x10degrees != Owb::checkStatus) {
-        D(F("SMA Appended: ")); DL(x10degrees);
-        return sma.append(x10degrees);
-    } else {
-        DL(F("Not recording faulty temperature!"));
-        return Owb::checkStatus;
+void wait_conversion(void) {
+    start_conversions(tempResolutionSma);
+    sleep_for(convertMs);  // one conversion period for both buses
+    if (!conversions_done()) {  // only DS18S20s, or a WDT running fast
+        Millis start = millis();
+        DL(F("Waiting on conversion"));
+        while (!conversions_done() &&
+               (millis() - start) < (tempConvertMax - convertMs))
+            ;
     }
+    read_temps();
+    owb_power(false); // no need to stay on
 }
 
 void sleep(void) {
@@ -395,10 +668,8 @@ void updateWake(TimedEvent* timed_event) {
         update_time();
         timed_event->reset();  // count from now, not when slept
         // Zap old temperature readings
-        sma.owbA.status = OwbStatus::none;
-        sma.owbB.status = OwbStatus::none;
-        sma.owbA.x10degrees = Owb::checkStatus;
-        sma.owbB.x10degrees = Owb::checkStatus;
+        owb_zap(sma.owbA);
+        owb_zap(sma.owbB);
         D(F("Wake up: ")); D(millis());
         D(F("ms sleep #: ")); D(sleepCycleCounter);
         D(F(" adjusted Time: ")); D(currentTime); DL(F("ms"));
@@ -421,28 +692,31 @@ void updateBattery(TimedEvent* timed_event) {
     }
 }
 
-void updateOneHour(TimedEvent* timed_event) {
-    wait_conversion();
-    D(currentTime); D(F(" 1H SMA append: ")); D(sma.owbA.x10degrees);
-    D(F(" / ")); DL(sma.owbB.x10degrees);
-    sma_append(sma.owbA.oneHour, sma.owbA.x10degrees);
-    sma_append(sma.owbB.oneHour, sma.owbB.x10degrees);
+void sma_sample(Sensor& sensor) {
+    bool good = (sensor.status == OwbStatus::complete) &&
+                (sensor.x10degrees != Sensor::checkStatus);
+
+    if (good) {
+        D(F("History sample: ")); DL(sensor.x10degrees);
+    } else
+        DL(F("Not recording faulty temperature!"));
+    sensor.history.sample(sensor.x10degrees, good);  // keeps its slot
 }
 
-void updateFourHour(TimedEvent* timed_event) {
-    wait_conversion();
-    D(currentTime); D(F(" 4H SMA append: ")); D(sma.owbA.x10degrees);
-    D(F(" / ")); DL(sma.owbB.x10degrees);
-    sma_append(sma.owbA.fourHour, sma.owbA.x10degrees);
-    sma_append(sma.owbB.fourHour, sma.owbB.x10degrees);
+// Every slot, found or not, read or not, so no history falls off the
+// clock while its sensor or the whole bus is missing
+void sma_update(Owb& owb) {
+    for (uint8_t i = 0; i < owbSensors; i++)
+        sma_sample(owb.sensor[i]);
 }
 
-void updateTwelveHour(TimedEvent* timed_event) {
+// One conversion per tempSmaSample feeds the hourly and daily history
+void updateSma(TimedEvent* timed_event) {
     wait_conversion();
-    D(currentTime); D(F(" 12H SMA append: ")); D(sma.owbA.x10degrees);
-    D(F(" / ")); DL(sma.owbB.x10degrees);
-    sma_append(sma.owbA.twelveHour, sma.owbA.x10degrees);
-    sma_append(sma.owbB.twelveHour, sma.owbB.x10degrees);
+    D(currentTime); D(F(" SMA append: ")); D(sma.owbA.sensor[0].x10degrees);
+    D(F(" / ")); DL(sma.owbB.sensor[0].x10degrees);
+    sma_update(sma.owbA);
+    sma_update(sma.owbB);
 }
 
 void lcdPrintTemp(int16_t centi_temp) {
@@ -468,53 +742,104 @@ void lcdPrintBattMv(void) {
     }
 }
 
+// Sensors shown a page at a time, the bus with the most sets the count
+uint8_t sensor_pages(void) {
+    uint8_t pages = max(sma.owbA.roms.count, sma.owbB.roms.count);
+    return pages ? pages : 1;
+}
+
+inline uint8_t enc_max(void) {
+    return EncState::battery * sensor_pages();  // battery has one page
+}
+
+inline uint8_t enc_view(void) {
+    return min(encValue / sensor_pages(), EncState::battery);
+}
+
+inline uint8_t enc_page(void) {
+    return (enc_view() == EncState::battery) ? 0 : encValue % sensor_pages();
+}
+
+void lcdPrintSensor(Owb& owb, uint8_t view, uint8_t page) {
+    if (page >= owb.roms.count) {
+        lcd.print("  --  ");
+        return;
+    }
+    Sensor& sensor = owb.sensor[page];
+    const int16_t none = Sensor::checkStatus;
+    switch (view) {
+        case EncState::current: lcdPrintTemp(sensor.x10degrees); break;
+        case EncState::hour:
+            lcdPrintTemp(sensor.history.hourly().last(none)); break;
+        case EncState::day:
+            lcdPrintTemp(sensor.history.hourly().mean(none)); break;
+        case EncState::dayLow:
+            lcdPrintTemp(sensor.history.hourly().low(none)); break;
+        case EncState::dayHigh:
+            lcdPrintTemp(sensor.history.hourly().high(none)); break;
+        case EncState::week:
+            lcdPrintTemp(sensor.history.daily().mean(none)); break;
+        case EncState::weekLow:
+            lcdPrintTemp(sensor.history.daily().low(none)); break;
+        case EncState::weekHigh:
+            lcdPrintTemp(sensor.history.daily().high(none)); break;
+    }
+}
+
 void updateLcdData(void) {  // Only update values
+    uint8_t view = enc_view();
+
     lcd.setCursor(2, 1);
-    switch (encValue) {
-        case EncState::current: lcdPrintTemp(sma.owbA.x10degrees); break;
-        case EncState::one:     lcdPrintTemp(sma.owbA.oneHour.value()); break;
-        case EncState::four:    lcdPrintTemp(sma.owbA.fourHour.value()); break;
-        case EncState::twelve:  lcdPrintTemp(sma.owbA.twelveHour.value()); break;
-        case EncState::battery: lcdPrintBattMv(); break;
-    }
+    if (view == EncState::battery)
+        lcdPrintBattMv();
+    else
+        lcdPrintSensor(sma.owbA, view, enc_page());
     lcd.setCursor(10, 1);
-    switch (encValue) {
-        case EncState::current: lcdPrintTemp(sma.owbB.x10degrees); break;
-        case EncState::one:     lcdPrintTemp(sma.owbB.oneHour.value()); break;
-        case EncState::four:    lcdPrintTemp(sma.owbB.fourHour.value()); break;
-        case EncState::twelve:  lcdPrintTemp(sma.owbB.twelveHour.value()); break;
-        case EncState::battery: lcd.print(percentBattery()); break;
-    }
+    if (view == EncState::battery)
+        lcd.print(percentBattery());
+    else
+        lcdPrintSensor(sma.owbB, view, enc_page());
 }
 
+#ifdef DEBUG
+    void debugOwb(Owb& owb) {
+        D(F(" status: ")); DL(owb.status);
+        for (uint8_t i = 0; i < owb.roms.count; i++) {
+            D(F("  #")); D(i + 1);
+            D(F(" status: ")); D(owb.sensor[i].status);
+            D(F(" x10 Temp: ")); D(owb.sensor[i].x10degrees);
+            D(F(" 1h: ")); D(owb.sensor[i].history.hourly().last());
+            D(F(" 24h: ")); D(owb.sensor[i].history.hourly().mean());
+            D(F(" 7d: ")); DL(owb.sensor[i].history.daily().mean());
+        }
+    }
+#endif // DEBUG
+
 void refreshLcd(void) {  // Paint entire screen
+    uint8_t view = enc_view();
+
     #ifdef DEBUG
         D(F("wakeCounter: ")); DL(wakeCounter);
-        D(F("\nOWB A"));
-        D(F(" status: ")); D(sma.owbA.status);
-        D(F(" x10 Temp: ")); D(sma.owbA.x10degrees);
-        D(F(" 1hSMA: ")); D(sma.owbA.oneHour.value());
-        D(F(" 4hSMA: ")); D(sma.owbA.fourHour.value());
-        D(F(" 12hSMA: ")); DL(sma.owbA.twelveHour.value());
-        D(F("OWB B"));
-        D(F(" status: ")); D(sma.owbB.status);
-        D(F(" x10 Temp: ")); D(sma.owbB.x10degrees);
-        D(F(" 1hSMA: ")); D(sma.owbB.oneHour.value());
-        D(F(" 4hSMA: ")); D(sma.owbB.fourHour.value());
-        D(F(" 12hSMA: ")); DL(sma.owbB.twelveHour.value());
+        D(F("\nOWB A")); debugOwb(sma.owbA);
+        D(F("OWB B")); debugOwb(sma.owbB);
     #endif // DEBUG
     lcd.setCursor(0, 0);
-    switch (encValue) {
+    switch (view) {
         case EncState::current: lcd.print("Current Temp.   "); break;
-        case EncState::one:     lcd.print("1 Hour SMA Temp."); break;
-        case EncState::four:    lcd.print("4 Hour SMA Temp."); break;
-        case EncState::twelve:  lcd.print("12Hour SMA Temp."); break;
+        case EncState::hour:     lcd.print("Last Hour Avg.  "); break;
+        case EncState::day:      lcd.print("24 Hour Average "); break;
+        case EncState::dayLow:   lcd.print("24 Hour Low     "); break;
+        case EncState::dayHigh:  lcd.print("24 Hour High    "); break;
+        case EncState::week:     lcd.print("7 Day Average   "); break;
+        case EncState::weekLow:  lcd.print("7 Day Low       "); break;
+        case EncState::weekHigh: lcd.print("7 Day High      "); break;
         case EncState::battery: lcd.print("Battery Power   "); break;
     }
     lcd.setCursor(0, 1);
-    if (encValue != EncState::battery)
-        lcd.print("A:      B:      ");
-    else
+    if (view != EncState::battery) {  // "A1      B1      "
+        lcd.print("A"); lcd.print(enc_page() + 1); lcd.print("      ");
+        lcd.print("B"); lcd.print(enc_page() + 1); lcd.print("      ");
+    } else
         lcd.print("        V    %  ");
     updateLcdData();
     lcdRefresh = false;
@@ -535,11 +860,11 @@ void updateLcd(TimedEvent* timed_event) {
 void updateEnc(TimedEvent* timed_event) {
     int32_t newPosition = enc.read() / 4;
 
-    if (newPosition > lowByte(encMinMax)) {
-        newPosition = highByte(encMinMax);
+    if (newPosition > enc_max()) {  // every view and sensor page
+        newPosition = 0;
         enc.write(newPosition * 4);
-    } else if (newPosition < highByte(encMinMax)) {
-        newPosition = lowByte(encMinMax);
+    } else if (newPosition < 0) {
+        newPosition = enc_max();
         enc.write(newPosition * 4);
     }
 
@@ -607,15 +932,9 @@ void setup(void) {
 }
 
 void loop(void) {
-    static TimedEvent oneHourUpdate(currentTime,
-                                    tempSmaSample,  // 10 minutes
-                                    updateOneHour);
-    static TimedEvent fourHourUpdate(currentTime,
-                                     tempSmaSample,
-                                     updateFourHour);
-    static TimedEvent twelveHourUpdate(currentTime,
-                                       tempSmaOne,  // one hour
-                                       updateTwelveHour);
+    static TimedEvent smaUpdate(currentTime,
+                                tempSmaSample,  // 10 minutes
+                                updateSma);
     static TimedEvent batteryUpdate(currentTime,
                                     batterySample,  // 45 minutes
                                     updateBattery);
@@ -629,9 +948,7 @@ void loop(void) {
                                 lcdTime,
                                 updateLcd);
     batteryUpdate.update(); update_time();
-    oneHourUpdate.update(); update_time();
-    fourHourUpdate.update(); update_time();
-    twelveHourUpdate.update(); update_time();
+    smaUpdate.update(); update_time();
     button.process(); update_time();
     encUpdate.update(); update_time();
     lcdUpdate.update(); update_time();
@@ -0,0 +1,205 @@
+#ifndef OWBASYNC_H
+#define OWBASYNC_H
+
+// 1-Wire jobs run by Timer1 compare interrupts, on the buses of one port in
+// lock-step like OwbPort.  owb_queue() starts the reset and returns, the
+// writes and reads follow slot by slot, and job.done is set at the end.
+// Each slot runs in the compare ISR with interrupts off: the pull low first,
+// then 10us to release a write's 1s or 13us to sample a read, then working
+// out the next slot.  Between ISRs the CPU is free or idle asleep, a write's
+// 0s are held low by the port.  Timer1 only runs while a job does.
+
+struct OwbJob {
+    uint8_t mask; // buses to reset, write and read
+    const uint8_t* tx[OwbPort::bits]; // after the reset, by port bit number
+    uint8_t txLen[OwbPort::bits]; // a bus idles once its bytes are sent
+    uint8_t* rx[OwbPort::bits]; // then rxLen bytes read into each
+    uint8_t rxLen;
+    bool power; // hold the buses high after the last write, for Convert T
+    volatile uint8_t present; // buses that answered the reset
+    volatile bool done;
+};
+
+struct OwbPhase {
+    static const uint8_t resetRelease = 0;
+    static const uint8_t resetSample = 1;
+    static const uint8_t slot = 2;
+    static const uint8_t writeEnd = 3;
+};
+
+struct OwbAsync {
+    static const uint8_t ticksPerUs = 2; // Timer1 at clk/8
+    OwbJob* volatile job; // NULL when idle
+    volatile IO_REG_TYPE* reg;
+    uint8_t phase;
+    uint8_t index; // byte of tx or rx
+    uint8_t bitMask; // bit of that byte
+    bool reading; // writes are done
+    uint8_t slotMask; // buses in the next or current slot, 0 to finish
+    uint8_t slotOnes; // of those, the ones writing a 1
+    OwbAsync(uint8_t pin) : job(NULL), reg(PIN_TO_BASEREG(pin)) {};
+};
+
+extern OwbAsync owbAsync;
+
+// Next compare us after the last one, it's where the slot timing counts from
+inline void owb_async_next(uint16_t us, uint8_t phase) {
+    OCR1A = us * OwbAsync::ticksPerUs - 1;
+    if (TCNT1 >= OCR1A)  // ran long, don't wait a whole Timer1 wrap
+        OCR1A = TCNT1 + 1;
+    owbAsync.phase = phase;
+}
+
+void owb_async_finish(void) {
+    OwbJob* job = owbAsync.job;
+
+    if (!job->power) {
+        DIRECT_MODE_INPUT(owbAsync.reg, job->mask);
+        DIRECT_WRITE_LOW(owbAsync.reg, job->mask);
+    }
+    TIMSK1 = 0;
+    TCCR1B = 0;  // stopped
+    power_timer1_disable();
+    job->done = true;
+    owbAsync.job = NULL;  // the caller's from here
+}
+
+// Buses still with a byte to send
+uint8_t owb_async_writers(OwbJob* job) {
+    uint8_t mask = 0;
+    for (uint8_t bus = 1; bus; bus <<= 1)
+        if ((job->present & bus) &&
+            (owbAsync.index < job->txLen[OwbPort::bitnum(bus)]))
+            mask |= bus;
+    return mask;
+}
+
+// Work out the next slot's buses and bits while waiting for it, so the
+// slot itself can start with the pull low
+void owb_async_prepare(void) {
+    OwbJob* job = owbAsync.job;
+    uint8_t mask = 0;
+
+    if (!owbAsync.reading) {
+        mask = owb_async_writers(job);
+        if (mask) {
+            uint8_t ones = 0;
+            for (uint8_t bus = 1; bus; bus <<= 1)
+                if ((mask & bus) &&
+                    (job->tx[OwbPort::bitnum(bus)][owbAsync.index] &
+                     owbAsync.bitMask))
+                    ones |= bus;
+            owbAsync.slotMask = mask;
+            owbAsync.slotOnes = ones;
+            return;
+        }
+        owbAsync.reading = true;
+        owbAsync.index = 0;
+        owbAsync.bitMask = 0x01;
+    }
+    mask = job->present;
+    if (owbAsync.index >= job->rxLen)
+        mask = 0;  // all read
+    if (mask && owbAsync.bitMask == 0x01)
+        for (uint8_t bus = 1; bus; bus <<= 1)
+            if (mask & bus)
+                job->rx[OwbPort::bitnum(bus)][owbAsync.index] = 0;
+    owbAsync.slotMask = mask;
+}
+
+inline void owb_async_advance(void) {
+    if (!(owbAsync.bitMask <<= 1)) {
+        owbAsync.bitMask = 0x01;
+        owbAsync.index++;
+    }
+}
+
+// Run the prepared write or read slot, or finish the job
+void owb_async_slot(void) {
+    OwbJob* job = owbAsync.job;
+    volatile IO_REG_TYPE* reg = owbAsync.reg;
+    uint8_t mask = owbAsync.slotMask;
+
+    if (!mask) {
+        owb_async_finish();
+        return;
+    }
+    if (!owbAsync.reading) {
+        DIRECT_WRITE_LOW(reg, mask);
+        DIRECT_MODE_OUTPUT(reg, mask);  // drive output low
+        delayMicroseconds(10);
+        DIRECT_WRITE_HIGH(reg, owbAsync.slotOnes);  // 1s end their pulse
+        owb_async_advance();
+        owb_async_next(65, OwbPhase::writeEnd);
+        return;
+    }
+    DIRECT_MODE_OUTPUT(reg, mask);
+    DIRECT_WRITE_LOW(reg, mask);
+    delayMicroseconds(3);
+    DIRECT_MODE_INPUT(reg, mask);  // let pin float, pull up will raise
+    delayMicroseconds(10);
+    uint8_t r = *reg & mask;
+    for (uint8_t bus = 1; bus; bus <<= 1)
+        if (r & bus)
+            job->rx[OwbPort::bitnum(bus)][owbAsync.index] |= owbAsync.bitMask;
+    owb_async_advance();
+    owb_async_prepare();
+    owb_async_next(70, OwbPhase::slot);
+}
+
+ISR(TIMER1_COMPA_vect) {
+    OwbJob* job = owbAsync.job;
+
+    switch (owbAsync.phase) {
+        case OwbPhase::resetRelease:
+            DIRECT_MODE_INPUT(owbAsync.reg, job->mask);  // allow it to float
+            owb_async_next(70, OwbPhase::resetSample);
+            break;
+        case OwbPhase::resetSample:
+            job->present = ~(*owbAsync.reg) & job->mask;
+            owb_async_prepare();
+            owb_async_next(410, OwbPhase::slot);
+            break;
+        case OwbPhase::writeEnd:
+            DIRECT_WRITE_HIGH(owbAsync.reg, owbAsync.slotMask);
+            owb_async_prepare();
+            owb_async_next(10, OwbPhase::slot);
+            break;
+        case OwbPhase::slot:
+            owb_async_slot();
+            break;
+    }
+}
+
+bool owb_busy(void) {
+    return owbAsync.job != NULL;
+}
+
+// Start job with a reset, false if another job is still running
+bool owb_queue(OwbJob& job) {
+    if (owb_busy())
+        return false;
+    job.present = 0;
+    job.done = false;
+    owbAsync.job = &job;
+    owbAsync.index = 0;
+    owbAsync.bitMask = 0x01;
+    owbAsync.reading = false;
+    noInterrupts();
+    DIRECT_MODE_INPUT(owbAsync.reg, job.mask);
+    job.mask &= *owbAsync.reg;  // shorted buses sit this one out
+    DIRECT_WRITE_LOW(owbAsync.reg, job.mask);
+    DIRECT_MODE_OUTPUT(owbAsync.reg, job.mask);  // drive output low
+    power_timer1_enable();
+    TCCR1A = 0;
+    TCCR1B = 0;
+    TCNT1 = 0;
+    owb_async_next(480, OwbPhase::resetRelease);
+    TIFR1 = _BV(OCF1A);
+    TIMSK1 = _BV(OCIE1A);
+    TCCR1B = _BV(WGM12) | _BV(CS11);  // CTC on OCR1A, clk/8
+    interrupts();
+    return true;
+}
+
+#endif // OWBASYNC_H
@@ -0,0 +1,50 @@
+#ifndef OWBPORT_H
+#define OWBPORT_H
+
+// Several 1-Wire buses on one port, driven in lock-step.  Every slot
+// pulls all the buses in a mask low together, releases the ones sending a
+// 1 early, and samples them all with one port read, so N buses take one
+// bus time.  Buses are named by their port bit mask, per bus data is
+// indexed by port bit number.  Transactions run from Timer1, see
+// OwbAsync.h, searching and CRCs stay with OneWire.
+
+#if !defined(__AVR__)
+    #error "OwbPort needs the AVR port registers"
+#endif
+
+class OwbPort {
+    private:
+        volatile IO_REG_TYPE *baseReg;
+
+    public:
+        static const uint8_t bits = 8;
+
+        // Port bit number of a single bus mask
+        static uint8_t bitnum(uint8_t mask) {
+            uint8_t bit = 0;
+            while (mask >>= 1)
+                bit++;
+            return bit;
+        }
+
+        OwbPort(uint8_t pin) : baseReg(PIN_TO_BASEREG(pin)) {};
+
+        // One read slot on every bus in mask, return the ones that read 1
+        uint8_t read_bit(uint8_t mask) {
+            volatile IO_REG_TYPE *reg IO_REG_ASM = baseReg;
+            uint8_t r;
+
+            noInterrupts();
+            DIRECT_MODE_OUTPUT(reg, mask);
+            DIRECT_WRITE_LOW(reg, mask);
+            delayMicroseconds(3);
+            DIRECT_MODE_INPUT(reg, mask);  // let pin float, pull up will raise
+            delayMicroseconds(10);
+            r = *reg & mask;
+            interrupts();
+            delayMicroseconds(53);
+            return r;
+        }
+};
+
+#endif // OWBPORT_H
@@ -0,0 +1,166 @@
+#ifndef TEMPHISTORY_H
+#define TEMPHISTORY_H
+
+// Temperature history downsampled a level at a time so a week fits in a
+// couple hundred bytes.  Samples add to the hour in progress, each hour
+// becomes a mean/low/high bucket and adds to the day in progress, each day
+// becomes a bucket too.  The hour and day rings keep running sums, their
+// means are O(1), low and high scan the ring (24 buckets at most).
+
+struct TempBucket {
+    int16_t mean;
+    int16_t low;
+    int16_t high;
+};
+
+// Samples, or whole hours, going into the next bucket
+struct TempAccum {
+    long sum;
+    uint16_t count;
+    int16_t low;
+    int16_t high;
+
+    TempAccum() : sum(0), count(0), low(0), high(0) {};
+
+    void clear(void) {
+        sum = 0;
+        count = 0;
+    }
+
+    void add(int16_t point) {
+        if (!count || point < low)
+            low = point;
+        if (!count || point > high)
+            high = point;
+        sum += point;
+        count++;
+    }
+
+    // Roll up a finished level, as if its samples were added here
+    void add(const TempAccum& other) {
+        if (!other.count)
+            return;
+        if (!count || other.low < low)
+            low = other.low;
+        if (!count || other.high > high)
+            high = other.high;
+        sum += other.sum;
+        count += other.count;
+    }
+
+    // Bucket of everything added, then start over
+    TempBucket take(void) {
+        TempBucket bucket = { (int16_t)(sum / count), low, high };
+        sum = 0;
+        count = 0;
+        return bucket;
+    }
+};
+
+// The last N buckets of one level
+template <uint8_t N>
+class TempRing {
+    private:
+        TempBucket buckets[N];
+        uint8_t head; // where the next bucket goes
+        uint8_t count;
+        long sum; // of the means
+
+    public:
+        TempRing() : head(0), count(0), sum(0) {};
+
+        void clear(void) {
+            head = 0;
+            count = 0;
+            sum = 0;
+        }
+
+        void append(const TempBucket& bucket) {
+            if (count == N)
+                sum -= buckets[head].mean;
+            else
+                count++;
+            buckets[head] = bucket;
+            sum += bucket.mean;
+            head = (head + 1) % N;
+        }
+
+        uint8_t size(void) const { return count; }
+
+        // Mean of the newest bucket
+        int16_t last(int16_t empty = 0) const {
+            return count ? buckets[(head + N - 1) % N].mean : empty;
+        }
+
+        int16_t mean(int16_t empty = 0) const {
+            return count ? (int16_t)(sum / count) : empty;
+        }
+
+        int16_t low(int16_t empty = 0) const {
+            if (!count)
+                return empty;
+            int16_t result = buckets[0].low;
+            for (uint8_t i = 1; i < count; i++)
+                if (buckets[i].low < result)
+                    result = buckets[i].low;
+            return result;
+        }
+
+        int16_t high(int16_t empty = 0) const {
+            if (!count)
+                return empty;
+            int16_t result = buckets[0].high;
+            for (uint8_t i = 1; i < count; i++)
+                if (buckets[i].high > result)
+                    result = buckets[i].high;
+            return result;
+        }
+};
+
+// PerHour samples an hour, Hours kept, PerDay hours a day, Days kept
+template <uint8_t PerHour, uint8_t Hours, uint8_t PerDay, uint8_t Days>
+class TempHistory {
+    private:
+        TempAccum hour;
+        TempAccum day;
+        uint8_t hourSlots; // samples into this hour, good or bad
+        uint8_t daySlots; // hours into this day, empty or not
+        TempRing<Hours> hours;
+        TempRing<Days> days;
+
+    public:
+        TempHistory() : hourSlots(0), daySlots(0) {};
+
+        // Forget every sample, the slot counts carry on with the clock
+        void clear(void) {
+            hour.clear();
+            day.clear();
+            hours.clear();
+            days.clear();
+        }
+
+        // Once per sample period, good or not, so buckets stay on the clock.
+        // A bucket with no good samples is skipped, not recorded.
+        void sample(int16_t point, bool good) {
+            if (good)
+                hour.add(point);
+            if (++hourSlots < PerHour)
+                return;
+            hourSlots = 0;
+            if (hour.count) {
+                day.add(hour);
+                hours.append(hour.take());
+            }
+            if (++daySlots < PerDay)
+                return;
+            daySlots = 0;
+            if (day.count)
+                days.append(day.take());
+        }
+
+        const TempRing<Hours>& hourly(void) const { return hours; }
+
+        const TempRing<Days>& daily(void) const { return days; }
+};
+
+#endif // TEMPHISTORY_H
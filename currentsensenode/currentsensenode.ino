@@ -24,6 +24,19 @@
     virtual wire: http://www.open.com.au/mikem/arduino/
 */
 
+// Must come before <RoboVac.h> so its logging macros are enabled
+#define DEBUG
+// Only sample just before each transmit, see power.h
+#define LOWPOWER
+// Stream the first channel's raw samples for replay/replay.cpp, no logging
+//#define CAPTURE
+#ifdef CAPTURE
+#undef DEBUG // keep the sample stream clean
+#undef LOWPOWER // needs every sample
+#endif
+
+#include <avr/sleep.h>
+#include <avr/power.h>
 #include <TimedEvent.h>
 #include <VirtualWire.h>
 #include <RoboVac.h>
@@ -31,24 +44,21 @@
 /* Externals */
 
 /* Definitions */
-#define DEBUG
 #define NODEID 0x01
 
 // Constants used once (to save space)
-#define SENSEINTERVAL 101
+#define SENSEINTERVAL (1000 * GOERTZELCYCLES / ACHERTZ + 1) // one block
 #define STATUSINTERVAL 6003
 #define OVERRIDEAMOUNT (60000 * 3)
 
 // AC Frequency
 #define ACHERTZ (60)
-// Number of measurements to capture per wavelength
+// Number of measurements to capture per wavelength, see sampler.h
 #define SAMPLESPERWAVE (20)
-// Wavelength in microseconds
-#define ACWAVELENGTH (1000000.0/(ACHERTZ))
-// Number of microseconds per sample (MUST be larger than AnalogRead)
-#define MICROSPERSAMPLE ((ACWAVELENGTH) / (SAMPLESPERWAVE))
-// Threshold Sensitivity
-#define THRESHOLDLIMIT (127)
+// Threshold Sensitivity, RMS ADC counts at full pot (127 peak-to-peak sine)
+#define THRESHOLDLIMIT (45)
+// Tools sensed, the first this many currentSensePins, see sampler.h
+#define SENSECHANNELS (1)
 
 /* Types */
 
@@ -57,28 +67,35 @@ const int thresholdPin = A1;
 const int statusLEDPin = 13;
 const int txEnablePin = 7;
 const int txDataPin = 8;
-const int currentSensePin = A0;
+const int currentSensePins[] = { A0, A2, A3 }; // channel 1, 2, 3
 const int overridePin = 12;
 
 /* Global Variables */
 message_t message;
-unsigned long analogReadMicroseconds = 0; // measured in setup()
-int sampleLow = 0;
-int sampleHigh = 0;
-int sampleRange = 0;
-int threshold = 0;
+// Per channel, from the last updateCurrentEvent
+int sampleLow[SENSECHANNELS];
+int sampleHigh[SENSECHANNELS];
+word sampleRMS[SENSECHANNELS]; // Q(RMSFRACTION) AC RMS
+word sampleTone[SENSECHANNELS]; // Q(RMSFRACTION) RMS at ACHERTZ + harmonics
+int sampleDC[SENSECHANNELS]; // Q(RMSFRACTION) 0 amp level less SAMPLECENTER
+word threshold = 0; // Q(RMSFRACTION) sampleTone for "tool running"
 unsigned long overrideTime = 0; // millis when manual override expires
 
+#include "rms.h"
+#include "goertzel.h"
+#include "sampler.h"
+#include "power.h"
+
 /* Functions */
 
 void txEvent(TimerInformation *Sender) {
-    if (thresholdBreached()) {
-        digitalWrite(txEnablePin, HIGH);
-        makeMessage(&message, byte(NODEID));
+    byte channels = thresholdBreached();
+
+    if (channels != 0) { // one frame for all of them
+        powerTxOn(); // powerTxCheck() turns it off again
+        makeMessage(&message, byte(NODEID), channels);
         vw_send((uint8_t *) &message, MESSAGESIZE);
-        PRINTMESSAGE(millis(), message, 0);
-    } else {
-        digitalWrite(txEnablePin, LOW);
+        PRINTMESSAGE(message, 0);
     }
 
     // Check override button during slow event
@@ -88,41 +105,41 @@ void txEvent(TimerInformation *Sender) {
 }
 
 void updateCurrentEvent(TimerInformation *Sender) {
-    char index=0;
-    char sample=0;
-
-    // reset data
-    sampleHigh = 0;
-    sampleLow = 0;
-    sampleRange = 0;
-
-    threshold = map( analogRead(thresholdPin), 0, 1023, 0, THRESHOLDLIMIT);
-    // Fill data elements
-    for (index=0; index< SAMPLESPERWAVE; index++) {
-        sample= map( analogRead(currentSensePin),
-                     0, 1023,
-                     -512, 512);
-        if (sample > sampleHigh) {
-            sampleHigh = sample;
-        } else if (sample < sampleLow) {
-            sampleLow = sample;
+    // ISR(ADC_vect) did the sampling, just pick up the last AC cycle
+    sampleWindow_t window;
+
+    threshold = map(readThreshold(), 0, 1023,
+                    0, (long) THRESHOLDLIMIT << RMSFRACTION);
+    for (byte channel=0; channel < SENSECHANNELS; channel++) {
+        if (readSampleWindow(channel, &window) == false) {
+            continue; // no cycle finished since last time, keep old results
         }
-        // wait difference between MICROSPERSAMPLE and analogReadMicroseconds
-        delayMicroseconds(MICROSPERSAMPLE - analogReadMicroseconds);
+        sampleHigh[channel] = window.high;
+        sampleLow[channel] = window.low;
+        sampleRMS[channel] = windowRMS(&window);
+        sampleTone[channel] = windowTone(&window);
+        sampleDC[channel] = windowDC(&window);
     }
-    sampleRange = sampleHigh - sampleLow;
 }
 
-boolean thresholdBreached() {
-    if (sampleRange >= threshold) {
+byte thresholdBreached() {
+    // bit (channel - 1) set per channel over threshold, all in override
+    byte result = 0;
+
+    for (byte channel=0; channel < SENSECHANNELS; channel++) {
+        if (sampleTone[channel] >= threshold) { // ignores brush noise
+            result |= 1 << channel;
+        }
+    }
+    if (result != 0) {
         overrideTime = 0;
-        return true;
+        return result;
     } else { // under threshold
         if (overrideTime > millis()) {
-            return true; // still in override
+            return SAMPLEALLCHANNELS; // still in override
         } else {
             overrideTime = 0;
-            return false; // not in override
+            return 0; // not in override
         }
     }
 }
@@ -133,97 +150,104 @@ void incOverrideTime(void) {
     if (overrideTime > currentTime) {
         // Still override time in timer
         overrideTime += (OVERRIDEAMOUNT);
-        D("Override +: ");D(OVERRIDEAMOUNT);
+        LOG1(LOG_OVERRIDEINC, OVERRIDEAMOUNT);
     } else if (overrideTime < currentTime) { // less than currentMillis
         // First press
         overrideTime = currentTime + (OVERRIDEAMOUNT);
-        D("Override by: ");D(OVERRIDEAMOUNT);
+        LOG1(LOG_OVERRIDESTART, OVERRIDEAMOUNT);
     }
-    D("\n");
 }
 
+#ifdef LOWPOWER
+void sampleEvent(TimerInformation *Sender) {
+    // one window, then updateCurrentEvent() and txEvent() from loop()
+    sampleStart();
+}
+#endif // LOWPOWER
+
 void printStatusEvent(TimerInformation *Sender) {
+    // one channel per call, the log ring is too small for more
+    static byte channel = 0;
     unsigned long currentTime = millis();
+    unsigned long overrideLeft = 0;
 
-    PRINTTIME(currentTime);
-    D(" \t threshold: "); D(threshold);
-    D("  SampleHigh: "); D(sampleHigh);
-    D("  SampleLow: "); D(sampleLow);
-    D("  SampleRange: "); D(sampleRange);
     if (overrideTime > currentTime) {
-        D("  Override: "); D(overrideTime - currentTime);
+        overrideLeft = overrideTime - currentTime;
     }
-    D("\n");
+    LOG5(LOG_SENSESTATUS, channel + 1, threshold, sampleHigh[channel],
+         sampleLow[channel], overrideLeft);
+    LOG2(LOG_SENSERMS, sampleRMS[channel], sampleDC[channel]);
+    LOG1(LOG_SENSETONE, sampleTone[channel]);
+    channel = (channel + 1 < SENSECHANNELS) ? channel + 1 : 0;
+    LOG1(LOG_SENSEBUSY, sampleBusyCycles());
+#ifdef DEBUG
+    unsigned long awake = 0;
+    unsigned long adc = 0;
+    unsigned long tx = 0;
+    unsigned long current = powerStatus(&awake, &adc, &tx);
+
+    LOG4(LOG_SENSEPOWER, current, awake, adc, tx);
+#endif // DEBUG
 }
 
 /* Main Program */
 
 void setup() {
-    double startTime = 0;
-    double stopTime = 0;
-    double duration = 0;
-
 #ifdef DEBUG
     Serial.begin(SERIALBAUD);
 #endif // DEBUG
+#ifdef CAPTURE
+    Serial.begin(CAPTUREBAUD);
+#endif // CAPTURE
     pinMode(txDataPin, OUTPUT);
     vw_set_tx_pin(txDataPin);
     pinMode(txEnablePin, OUTPUT);
+    digitalWrite(txEnablePin, LOW);
     vw_set_ptt_pin(statusLEDPin);
     pinMode(statusLEDPin, OUTPUT);
     digitalWrite(statusLEDPin, LOW);
-    pinMode(currentSensePin, INPUT);
+    for (byte channel=0; channel < SENSECHANNELS; channel++) {
+        pinMode(currentSensePins[channel], INPUT);
+    }
     pinMode(overridePin, INPUT);
     vw_setup(RXTXBAUD);
-    // Capture the start time in microseconds
-    startTime = (millis() * 1000) + micros();
-    for (int counter = 0; counter < 10000; counter++) { // 10,000 analog reads for average (below)
-        analogRead(currentSensePin);
-    }
-    stopTime = (millis() * 1000) + micros();
-    // Calculate duration in microseconds
-    duration = stopTime - startTime;
-    // divide the duration by number of reads
-    analogReadMicroseconds = duration / 10000.0;
-
-    // Check Assumptions
-    if (analogReadMicroseconds > MICROSPERSAMPLE) {
-        while (1) {
-#ifdef DEBUG
-            D("Error: AnalogRead speed too slow!");
-#else
-            digitalWrite(statusLEDPin, HIGH);
-            delay(250);
-            digitalWrite(statusLEDPin, LOW);
-            delay(250);
-            digitalWrite(statusLEDPin, HIGH);
-            delay(250);
-            digitalWrite(statusLEDPin, LOW);
-            delay(1000);
-#endif // DEBUG
-        }
-    }
+    setupSampler(); // analogRead() can't be used from here on
+    setupPower();
 
     // Setup events
+#ifdef LOWPOWER
+    TimedEvent.addTimer(TXINTERVAL, sampleEvent); // loop() does the rest
+#else
     TimedEvent.addTimer(SENSEINTERVAL, updateCurrentEvent);
     TimedEvent.addTimer(TXINTERVAL, txEvent);
+#endif // LOWPOWER
     TimedEvent.addTimer(STATUSINTERVAL, printStatusEvent);
     D("setup()"); D(" Node ID: "); D(NODEID, DEC);
     D("\ntxDataPin: "); D(txDataPin);
     D("  txEnablePin: "); D(txEnablePin);
     D("  statusLEDPin: "); D(statusLEDPin);
-    D("  currentSensePin: "); D(currentSensePin);
+    D("  currentSensePins: "); D(SENSECHANNELS);
     D("  overridePin: "); D(overridePin);
     D("  RXTXBAUD: "); D(RXTXBAUD);
     D("\n");
     D("Threshold Limit: "); D(THRESHOLDLIMIT);
     D("  Smp. Per. Intvl: "); D(SAMPLESPERWAVE);
-    D("  Smp. Duration: "); D(MICROSPERSAMPLE);
-    D("us  analogRead: ");
-    D(analogReadMicroseconds);
-    D("us\n");
+    D("  Smp. Rate: "); D(F_CPU / 128 / (SAMPLETIMERTOP + 1) / SENSECHANNELS);
+    D("Hz per channel\n");
 }
 
 void loop() {
-    TimedEvent.loop(); // blocking
+#ifdef CAPTURE
+    captureSamples();
+#endif // CAPTURE
+    TimedEvent.loop();
+#ifdef LOWPOWER
+    if (sampleDone()) { // the window sampleEvent() started, act on it now
+        updateCurrentEvent(NULL);
+        txEvent(NULL);
+    }
+#endif // LOWPOWER
+    powerTxCheck();
+    LOGDRAIN(); // idle time, send queued log records
+    powerIdle(); // until the next interrupt
 }
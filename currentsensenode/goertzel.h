@@ -0,0 +1,74 @@
+#ifndef GOERTZEL_H
+#define GOERTZEL_H
+
+// Streaming Goertzel filters at ACHERTZ and its odd harmonics.  Unlike
+// peak or RMS detection they only respond to current locked to the mains
+// frequency, so brush noise and spikes barely register.  Blocks are
+// GOERTZELCYCLES whole AC cycles, which puts every harmonic exactly on a
+// bin and rejects the DC offset without tracking it.  Integer only, one
+// 32x16 bit multiply per harmonic per sample.
+// No AVR specifics in here, so the host harness can include it too.
+
+#define GOERTZELQ 14 // fraction bits of goertzelCoeff[]
+#define GOERTZELCYCLES 2 // AC cycles per block (33ms at 60Hz)
+#define GOERTZELHARMONICS 2 // 1 = ACHERTZ only, 2 adds 3rd, 3 adds 5th
+#define GOERTZELSCALE 2 // state bits dropped before squaring
+#define GOERTZELBLOCK ((GOERTZELCYCLES) * (SAMPLESPERWAVE))
+
+#if SAMPLESPERWAVE != 20
+#error "goertzelCoeff[] assumes 20 samples per AC cycle"
+#endif
+
+// 2 * cos(2 * pi * h / SAMPLESPERWAVE) for h = 1, 3, 5, in Q14
+const int goertzelCoeff[3] = { 31164, 19261, 0 };
+
+typedef struct goertzelState_s {
+    long s1[GOERTZELHARMONICS]; // previous filter output
+    long s2[GOERTZELHARMONICS]; // the one before that
+    byte count; // samples in this block
+    unsigned long power; // last block, see goertzelRMS()
+    byte blocks; // blocks finished, wraps
+} goertzelState_t;
+
+void goertzelReset(goertzelState_t *goertzel) {
+    memset(goertzel, 0, sizeof(goertzelState_t));
+}
+
+inline void goertzelSample(goertzelState_t *goertzel, int centred) {
+    // centred is the ADC reading less roughly the 0 amp level
+    for (byte h=0; h < GOERTZELHARMONICS; h++) {
+        long s0 = centred - goertzel->s2[h] +
+                  ((goertzelCoeff[h] * goertzel->s1[h]) >> GOERTZELQ);
+
+        goertzel->s2[h] = goertzel->s1[h];
+        goertzel->s1[h] = s0;
+    }
+    if (++goertzel->count < GOERTZELBLOCK) {
+        return;
+    }
+
+    // |X|^2 = s1^2 + s2^2 - coeff * s1 * s2, scaled down to fit 32 bits
+    goertzel->power = 0;
+    for (byte h=0; h < GOERTZELHARMONICS; h++) {
+        long s1 = goertzel->s1[h] >> GOERTZELSCALE;
+        long s2 = goertzel->s2[h] >> GOERTZELSCALE;
+        long power = (s1 * s1) + (s2 * s2) -
+                     (((goertzelCoeff[h] * s1) >> GOERTZELQ) * s2);
+
+        if (power > 0) { // rounding can leave a tiny negative
+            goertzel->power += power;
+        }
+        goertzel->s1[h] = 0;
+        goertzel->s2[h] = 0;
+    }
+    goertzel->count = 0;
+    goertzel->blocks++;
+}
+
+word goertzelRMS(unsigned long power) {
+    // Q(RMSFRACTION) RMS of the harmonics, sqrt(2 * sum |X|^2) / N
+    return ((unsigned long) isqrt(2 * power) <<
+            (GOERTZELSCALE + RMSFRACTION)) / GOERTZELBLOCK;
+}
+
+#endif // GOERTZEL_H
@@ -0,0 +1,115 @@
+#ifndef POWER_H
+#define POWER_H
+
+// Battery saving.  loop() idles the CPU until the next interrupt, unused
+// peripherals stay powered off, and the transmitter is only powered
+// while VirtualWire sends.  With LOWPOWER the ADC and Timer2 also only
+// run for a window just before each transmit (see sampleStart()), and
+// Timer1 only while sending.
+// Power-save and ADC noise reduction sleep would stop Timer2, which runs
+// from the system clock (the 32kHz crystal pins hold the 16MHz one), and
+// Timer0 with millis(), so idle is as deep as this board can go.
+// powerStatus() estimates the average supply current from how long each
+// part was on.  The per part currents are rough ATmega328P 5V/16MHz and
+// 433MHz module figures, calibrate them against a meter.
+
+#define POWERACTIVEUA 9000 // CPU running, not counting peripherals
+#define POWERIDLEUA 2500 // CPU idle, clocks still running
+#define POWERADCUA 300 // ADC enabled and converting
+#define POWERTXUA 6000 // transmitter while txEnablePin is HIGH
+
+typedef struct powerStats_s {
+    unsigned long since; // micros() the stats were last reset
+    unsigned long idle; // microseconds in powerIdle() since then
+    unsigned long txOn; // micros() txEnablePin went HIGH, 0 when LOW
+    unsigned long tx; // microseconds txEnablePin was HIGH since then
+    unsigned long windows; // sampleWindows when the stats were reset
+} powerStats_t;
+
+powerStats_t powerStats;
+
+void setupPower(void) {
+    // everything this node doesn't use, the rest is switched as needed
+    power_twi_disable();
+    power_spi_disable();
+#if !defined(DEBUG) && !defined(CAPTURE)
+    power_usart0_disable();
+#endif
+#ifdef LOWPOWER
+    power_timer1_disable(); // until powerTxOn()
+#endif // LOWPOWER
+    powerStats.since = micros();
+}
+
+void powerTxOn(void) {
+    // transmitter and VirtualWire's Timer1 up, call before vw_send()
+    if (powerStats.txOn == 0) {
+#ifdef LOWPOWER
+        power_timer1_enable();
+#endif // LOWPOWER
+        digitalWrite(txEnablePin, HIGH);
+        powerStats.txOn = micros() | 1; // never 0
+    }
+}
+
+void powerTxCheck(void) {
+    // transmitter and Timer1 off once VirtualWire is done
+    if ((powerStats.txOn != 0) && !vx_tx_active()) {
+        digitalWrite(txEnablePin, LOW);
+#ifdef LOWPOWER
+        power_timer1_disable();
+#endif // LOWPOWER
+        powerStats.tx += micros() - powerStats.txOn;
+        powerStats.txOn = 0;
+    }
+}
+
+void powerIdle(void) {
+    // sleep until the next interrupt, Timer0's within 1ms at the latest
+    unsigned long start = micros();
+
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sleep_mode();
+    powerStats.idle += micros() - start;
+}
+
+unsigned long powerStatus(unsigned long *awake, unsigned long *adc,
+                          unsigned long *tx) {
+    // Estimated average uA since the last call, and the parts' on time
+    // in 1000ths.  Millisecond sums so 6s at POWERACTIVEUA fits 32 bits.
+    unsigned long now = micros();
+    unsigned long span = (now - powerStats.since) / 1000;
+    unsigned long asleep = powerStats.idle / 1000;
+    unsigned long adcOn = span; // without LOWPOWER it never stops
+    unsigned long txOn = powerStats.tx / 1000;
+    unsigned long result = 0;
+
+#ifdef LOWPOWER
+    // the pot conversion squeezed into each window is ignored
+    adcOn = (sampleWindows - powerStats.windows) * SAMPLEWINDOW * 1000UL /
+            SAMPLERATE;
+    powerStats.windows = sampleWindows;
+#endif // LOWPOWER
+    if (powerStats.txOn != 0) { // still sending, count it up to now
+        txOn += (now - powerStats.txOn) / 1000;
+        powerStats.txOn = now | 1;
+    }
+    powerStats.since = now;
+    powerStats.idle = 0;
+    powerStats.tx = 0;
+    if (span == 0) {
+        *awake = *adc = *tx = 0;
+        return 0;
+    }
+    asleep = min(asleep, span);
+    adcOn = min(adcOn, span);
+    txOn = min(txOn, span);
+    result = ((span - asleep) * POWERACTIVEUA + asleep * POWERIDLEUA +
+              adcOn * POWERADCUA + txOn * POWERTXUA) / span;
+    *awake = (span - asleep) * 1000 / span;
+    *adc = adcOn * 1000 / span;
+    *tx = txOn * 1000 / span;
+    return result;
+}
+
+#endif // POWER_H
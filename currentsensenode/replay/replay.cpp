@@ -0,0 +1,387 @@
+/*
+  Host replay harness for currentsensenode tool detection
+
+  Feeds a sample stream through the sketch's own ISR(ADC_vect), loop(),
+  updateCurrentEvent() and thresholdBreached(), one sample per simulated
+  1/SAMPLERATE, and compares the result with when the tool was really on.
+
+  Build from the top of the sketchbook:
+
+    g++ -O2 -Irobovac/sim -Ilibraries/RoboVac -o replay \
+        currentsensenode/replay/replay.cpp libraries/RoboVac/RoboVac.cpp
+
+  Recorded, from a node built with CAPTURE at CAPTUREBAUD:
+
+    replay [-p pot] [-l labels] capture.bin
+
+  A labels file has "<seconds> on|off" lines, '#' starts a comment.
+  Without labels only the detections are listed.
+
+  Synthetic, random on/off periods of a tool:
+
+    replay [-p pot] [-s seed] [-t seconds] [-a amplitude] [-h third]
+           [-n noise] [-k spike] [-r spike%]
+
+  Amplitudes are peak ADC counts: -a of ACHERTZ, -h of its 3rd harmonic,
+  -n of random noise, and -k of spikes hitting -r percent of samples.
+  -p is the threshold pot reading, 0..1023.
+
+  Reports detection latency (tool on to thresholdBreached()), first
+  transmit latency, release latency, false positives and negatives, and
+  host time per sample.  The node logs its own ISR cycles (LOG_SENSEBUSY).
+  Samples taken while a LOWPOWER node has the ADC off are dropped, and
+  the ADC and transmitter duty cycles are reported too.  The stream is
+  the first channel's, any other SENSECHANNELS read a steady REPLAYDC.
+*/
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+
+#include <Arduino.h>
+
+// The Arduino IDE generates these, the sketch uses them before defining
+byte thresholdBreached();
+void incOverrideTime(void);
+
+#include "../currentsensenode.ino"
+
+#define REPLAYRATE ((double) F_CPU / 128 / (SAMPLETIMERTOP + 1) / \
+                    SENSECHANNELS) // real Hz per channel
+#define REPLAYMEANON 5.0 // seconds, synthetic tool on periods
+#define REPLAYMEANOFF 5.0 // seconds, synthetic tool off periods
+#define REPLAYDC 509 // synthetic 0 amp reading, a bit off SAMPLECENTER
+#define REPLAYMESSAGESIZE 9 // sizeof(message_t) on AVR, host padding differs
+#define REPLAYFRAMETIME ((48 + 12 * (1 + REPLAYMESSAGESIZE + 2)) * 1000UL /\
+                         RXTXBAUD) // ms on air, as robosim.cpp
+
+/* Simulated hardware */
+
+volatile uint8_t ADMUX = 0;
+volatile uint8_t ADCSRA = 0;
+volatile uint16_t ADC = 0;
+volatile uint8_t DIDR0 = 0;
+volatile uint8_t TCCR2A = 0;
+volatile uint8_t TCCR2B = 0;
+volatile uint8_t OCR2A = 0;
+volatile uint8_t TCNT2 = 0;
+volatile uint8_t TIMSK2 = 0;
+volatile uint8_t TIFR2 = 0;
+SimSerial Serial;
+SimTimedEvent TimedEvent;
+
+static unsigned long replayMillis = 0;
+static uint8_t digitalWriteTx = LOW; // txEnablePin
+static std::vector<unsigned long> transmits; // millis() of each vw_send()
+
+unsigned long millis(void) {
+    return replayMillis;
+}
+
+unsigned long micros(void) {
+    return replayMillis * 1000;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    if (pin == txEnablePin) {
+        digitalWriteTx = value;
+    }
+}
+
+int digitalRead(uint8_t pin) {
+    return LOW; // override button never pressed
+}
+
+size_t SimSerial::write(uint8_t value) {
+    return 1;
+}
+
+void vw_set_tx_pin(uint8_t pin) { }
+void vw_set_ptt_pin(uint8_t pin) { }
+void vw_setup(uint16_t speed) { }
+
+uint8_t vw_send(uint8_t *buf, uint8_t len) {
+    transmits.push_back(replayMillis);
+    return true;
+}
+
+uint8_t vx_tx_active(void) {
+    return !transmits.empty() &&
+           ((replayMillis - transmits.back()) < REPLAYFRAMETIME);
+}
+
+/* Sample streams */
+
+typedef struct {
+    unsigned long time; // millis()
+    boolean on;
+} replayLabel_t;
+
+static std::vector<word> samples;
+static std::vector<replayLabel_t> labels;
+
+static boolean readCapture(const char *fileName) {
+    // undo captureSamples(), a CAPTURELOST gap is filled with SAMPLECENTER
+    FILE *file = fopen(fileName, "rb");
+    int value = 0;
+    int first = -1;
+
+    if (file == NULL) {
+        perror(fileName);
+        return false;
+    }
+    while ((value = fgetc(file)) != EOF) {
+        if (value == CAPTURELOST) {
+            fprintf(stderr, "Samples lost at %.3fs\n",
+                    samples.size() / REPLAYRATE);
+            samples.insert(samples.end(), SAMPLERINGSIZE, SAMPLECENTER);
+            first = -1;
+        } else if (value & 0x80) {
+            first = value & 0x1F;
+        } else if (first >= 0) {
+            samples.push_back((first << 5) | (value & 0x1F));
+            first = -1;
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+static boolean readLabels(const char *fileName) {
+    FILE *file = fopen(fileName, "r");
+    char line[128];
+
+    if (file == NULL) {
+        perror(fileName);
+        return false;
+    }
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char state[8];
+        double seconds = 0;
+        replayLabel_t label;
+
+        line[strcspn(line, "#")] = '\0';
+        if (sscanf(line, " %lf %7s", &seconds, state) == 2) {
+            label.time = (unsigned long) (seconds * 1000);
+            label.on = (strcmp(state, "on") == 0);
+            labels.push_back(label);
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+static double randomUniform(void) {
+    return rand() / (RAND_MAX + 1.0);
+}
+
+static void synthesize(double seconds, double amplitude, double third,
+                       double noise, double spike, double spikePercent) {
+    // a tool switching on and off, with mains locked current while on
+    size_t count = seconds * REPLAYRATE;
+    boolean on = false;
+    size_t toggle = (-log(1.0 - randomUniform()) * REPLAYMEANOFF) *
+                    REPLAYRATE;
+
+    for (size_t index=0; index < count; index++) {
+        double phase = 2 * M_PI * ACHERTZ * index / REPLAYRATE;
+        double value = REPLAYDC + (noise * (2 * randomUniform() - 1));
+        replayLabel_t label;
+
+        if (index == toggle) {
+            on = !on;
+            label.time = index * 1000 / REPLAYRATE;
+            label.on = on;
+            labels.push_back(label);
+            toggle += (-log(1.0 - randomUniform()) *
+                       (on ? REPLAYMEANON : REPLAYMEANOFF)) * REPLAYRATE + 1;
+        }
+        if (on) {
+            value += (amplitude * sin(phase)) + (third * sin(3 * phase));
+        }
+        if (randomUniform() * 100 < spikePercent) {
+            value += (randomUniform() < 0.5) ? spike : -spike;
+        }
+        samples.push_back(max(0L, min(lround(value), 1023L)));
+    }
+}
+
+/* Replay */
+
+static unsigned long percentile(std::vector<unsigned long> values,
+                                int percent) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[((values.size() - 1) * percent) / 100];
+}
+
+static void printLatency(const char *name, std::vector<unsigned long> &values) {
+    printf("%-9s ms: n=%lu min %lu p50 %lu p90 %lu max %lu\n", name,
+           (unsigned long) values.size(), percentile(values, 0),
+           percentile(values, 50), percentile(values, 90),
+           percentile(values, 100));
+}
+
+int main(int argc, char *argv[]) {
+    word pot = 100;
+    unsigned int seed = 1;
+    double seconds = 600;
+    double amplitude = 20;
+    double third = 0;
+    double noise = 4;
+    double spike = 0;
+    double spikePercent = 0;
+    const char *labelFile = NULL;
+    std::vector<unsigned long> detect;
+    std::vector<unsigned long> transmit;
+    std::vector<unsigned long> release;
+    unsigned long onTime = 0; // samples labelled on
+    unsigned long missedTime = 0; // on, not detected, after first detect
+    unsigned long offTime = 0;
+    unsigned long falseTime = 0; // off, detected, after first release
+    unsigned long falseDetections = 0;
+    unsigned long missedPeriods = 0;
+    unsigned long changed = 0; // millis() label last changed
+    boolean labelOn = false;
+    boolean detected = false;
+    boolean settled = true; // first detect/release since the change
+    boolean transmitted = false; // since the tool came on
+    boolean listed = false; // last detection printed without labels
+    size_t nextLabel = 0;
+    size_t sent = 0; // transmits seen
+    double hostNanos = 0;
+    unsigned long converted = 0; // samples the ADC was on for
+    unsigned long sending = 0; // samples the transmitter was on for
+    int option = 0;
+
+    while ((option = getopt(argc, argv, "p:l:s:t:a:h:n:k:r:")) != -1) {
+        switch (option) {
+            case 'p': pot = atoi(optarg); break;
+            case 'l': labelFile = optarg; break;
+            case 's': seed = atoi(optarg); break;
+            case 't': seconds = atof(optarg); break;
+            case 'a': amplitude = atof(optarg); break;
+            case 'h': third = atof(optarg); break;
+            case 'n': noise = atof(optarg); break;
+            case 'k': spike = atof(optarg); break;
+            case 'r': spikePercent = atof(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-p pot] [-l labels] capture.bin\n"
+                        "       %s [-p pot] [-s seed] [-t seconds]"
+                        " [-a amplitude] [-h third] [-n noise] [-k spike]"
+                        " [-r spike%%]\n", argv[0], argv[0]);
+                return 1;
+        }
+    }
+
+    srand(seed);
+    if (optind < argc) {
+        if (!readCapture(argv[optind]) ||
+            ((labelFile != NULL) && !readLabels(labelFile))) {
+            return 1;
+        }
+    } else {
+        synthesize(seconds, amplitude, third, noise, spike, spikePercent);
+    }
+
+    setup();
+    thresholdRaw = pot;
+    for (size_t index=0; index < samples.size(); index++) {
+        unsigned long now = index * 1000 / REPLAYRATE;
+        struct timespec start;
+        struct timespec stop;
+        boolean breached = false;
+
+        replayMillis = now;
+        while ((nextLabel < labels.size()) &&
+               (labels[nextLabel].time <= now)) {
+            if (labelOn && !settled) { // never detected
+                missedPeriods++;
+            }
+            labelOn = labels[nextLabel++].on;
+            changed = now;
+            settled = false;
+            transmitted = false;
+        }
+
+        // Timer2 ticks started a conversion per channel, they complete
+        for (byte tick=0; tick < SENSECHANNELS; tick++) {
+            if ((ADCSRA & _BV(ADEN)) == 0) { // LOWPOWER, between windows
+                break;
+            }
+            ADC = (sampleChannel == 0) ? samples[index] : REPLAYDC;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            ADC_vect();
+            clock_gettime(CLOCK_MONOTONIC, &stop);
+            hostNanos += (stop.tv_sec - start.tv_sec) * 1e9 +
+                         (stop.tv_nsec - start.tv_nsec);
+            converted++;
+            if ((ADMUX & 0x07) == (thresholdPin - A0)) { // the pot's turn
+                ADC = pot;
+                ADC_vect();
+            }
+        }
+        loop();
+        sending += (digitalWriteTx == HIGH);
+
+        if (now < SENSEINTERVAL) {
+            continue; // threshold isn't read until updateCurrentEvent()
+        }
+        breached = thresholdBreached() & 0x01; // first channel's
+        if (breached && !detected && !labelOn) {
+            falseDetections++;
+        }
+        detected = breached;
+        if (labels.empty()) {
+            if (breached != listed) { // no labels, list the detections
+                printf("%.3fs %s\n", now / 1000.0, breached ? "on" : "off");
+                listed = breached;
+            }
+            continue;
+        }
+        if (!settled && (breached == labelOn)) {
+            (labelOn ? detect : release).push_back(now - changed);
+            settled = true;
+        }
+        if (labelOn && !transmitted && (transmits.size() > sent)) {
+            transmit.push_back(transmits.back() - changed);
+            transmitted = true;
+        }
+        sent = transmits.size();
+        if (labelOn) {
+            onTime++;
+            missedTime += (settled && !breached);
+        } else {
+            offTime++;
+            falseTime += (settled && breached);
+        }
+    }
+
+    printf("%lu samples (%.1fs at %.1fHz), threshold pot %u (%u/8 RMS)\n",
+           (unsigned long) samples.size(), samples.size() / REPLAYRATE,
+           REPLAYRATE, pot, threshold);
+    if (!labels.empty()) {
+        printLatency("Detect", detect);
+        printLatency("Transmit", transmit);
+        printLatency("Release", release);
+        printf("False positives: %lu detection(s), %.3f%% of off time\n",
+               falseDetections, offTime ? 100.0 * falseTime / offTime : 0);
+        printf("False negatives: %lu period(s) missed, %.3f%% of on time\n",
+               missedPeriods, onTime ? 100.0 * missedTime / onTime : 0);
+    }
+    printf("On time: ADC %.1f%%, transmitter %.1f%%\n",
+           samples.empty() ? 0 : 100.0 * converted /
+                                 (samples.size() * SENSECHANNELS),
+           samples.empty() ? 0 : 100.0 * sending / samples.size());
+    printf("Host time in ISR(ADC_vect): %.0fns per sample\n",
+           converted ? hostNanos / converted : 0);
+    return 0;
+}
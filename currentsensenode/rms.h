@@ -0,0 +1,60 @@
+#ifndef RMS_H
+#define RMS_H
+
+// Integer true-RMS of the current sense waveform.  Each sample has a
+// slowly tracked DC level taken out, keeping RMSFRACTION fractional bits,
+// and is squared into the AC cycle in progress.  Only whole cycles are
+// averaged, so a partial cycle never biases the result.  Per sample that
+// is a shift/subtract for the DC level and one 16x16 bit multiply.
+// No AVR specifics in here, so the host harness can include it too.
+
+#define RMSFRACTION 3 // fractional bits on centred samples and results
+#define RMSDCSHIFT 10 // DC level follows over ~2^10 samples (~0.85s)
+#define RMSMAXCYCLES 32 // cycles added up between reads
+
+// Overflow limits: centred samples stay within +/-(1023 << RMSFRACTION),
+// so a cycle of up to 64 samples and RMSMAXCYCLES cycle means fit 32 bits.
+
+typedef struct rmsState_s {
+    long dcLevel; // Q(RMSFRACTION + RMSDCSHIFT) ADC reading of 0 amps
+    unsigned long cycleSquares; // Q(2 * RMSFRACTION) cycle in progress
+    byte cycleCount; // samples in cycleSquares
+    unsigned long meanSquares; // whole cycle mean squares added up
+    byte cycles; // whole cycles in meanSquares
+} rmsState_t;
+
+void rmsReset(rmsState_t *rms, word center) {
+    // center is the expected 0 amp reading, tracking takes it from there
+    rms->dcLevel = (long) center << (RMSFRACTION + RMSDCSHIFT);
+    rms->cycleSquares = 0;
+    rms->cycleCount = 0;
+    rms->meanSquares = 0;
+    rms->cycles = 0;
+}
+
+inline void rmsSample(rmsState_t *rms, word raw, byte perCycle) {
+    long scaled = (long) raw << (RMSFRACTION + RMSDCSHIFT);
+    int centred = 0;
+
+    rms->dcLevel += (scaled - rms->dcLevel) >> RMSDCSHIFT;
+    centred = (int) (raw << RMSFRACTION) - (int) (rms->dcLevel >> RMSDCSHIFT);
+    rms->cycleSquares += (long) centred * centred;
+    if (++rms->cycleCount >= perCycle) {
+        if (rms->cycles < RMSMAXCYCLES) { // else nobody is reading
+            rms->meanSquares += rms->cycleSquares / perCycle;
+            rms->cycles++;
+        }
+        rms->cycleSquares = 0;
+        rms->cycleCount = 0;
+    }
+}
+
+word rmsResult(unsigned long meanSquares, byte cycles) {
+    // Q(RMSFRACTION) RMS of the cycles added up in meanSquares
+    if (cycles == 0) {
+        return 0;
+    }
+    return isqrt(meanSquares / cycles);
+}
+
+#endif // RMS_H
@@ -0,0 +1,290 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+// Timer2 starts an ADC conversion every 1/SAMPLERATE seconds for each of
+// SENSECHANNELS current sense pins in turn.  ISR(ADC_vect) keeps the peaks,
+// RMS (rms.h) and tone (goertzel.h) of whole AC cycles per channel, and
+// the raw samples of the first channel.
+// loop() only copies finished cycles, it never waits on the ADC.
+// With LOWPOWER the ADC and Timer2 only run for a SAMPLEWINDOW started by
+// sampleStart(), otherwise they sample all the time.
+// Timer2 because VirtualWire has Timer1 and millis() has Timer0, and
+// Timer2 can't auto-trigger the ADC so its ISR sets ADSC instead.
+
+#define SAMPLERATE ((ACHERTZ) * (SAMPLESPERWAVE)) // per channel per second
+#define SAMPLETICKRATE ((SAMPLERATE) * (SENSECHANNELS)) // Timer2 matches
+#define SAMPLETIMERTOP (((F_CPU / 128) + (SAMPLETICKRATE / 2)) / \
+                        SAMPLETICKRATE - 1)
+#define SAMPLERINGSIZE 32 // raw samples kept, power of two
+#define SAMPLECENTER 512 // ADC reading of 0 amps
+#define SAMPLEADCTICKS 13 // Timer2 ticks per conversion, ADC is clk/128 too
+#define CAPTUREBAUD 115200 // 2 bytes per sample is too much for 9600
+#define CAPTURELOST 0xE0 // sent when the ring overran, never a sample byte
+#define SAMPLEWINDOW (GOERTZELBLOCK) // LOWPOWER samples per sampleStart()
+#define SAMPLEALLCHANNELS ((1 << (SENSECHANNELS)) - 1) // channel mask
+
+// At 4 channels a conversion every 208us leaves no room for squeezing
+// in the thresholdPin conversion after one
+#if (SENSECHANNELS < 1) || (SENSECHANNELS > 3)
+#error "SENSECHANNELS must be 1 to 3"
+#endif
+
+typedef struct sampleWindow_s {
+    int high; // centred, most positive sample
+    int low; // centred, most negative sample
+    unsigned long meanSquares; // see rmsResult()
+    byte cycles; // whole AC cycles in meanSquares
+    long dcLevel; // tracked 0 amp reading, see rmsState_t
+    unsigned long tonePower; // last Goertzel block, see goertzelRMS()
+} sampleWindow_t;
+
+typedef struct sampleState_s {
+    int buildHigh; // centred, most positive sample since the last read
+    int buildLow; // centred, most negative sample since the last read
+    rmsState_t rms;
+    goertzelState_t goertzel;
+} sampleState_t;
+
+volatile word sampleRing[SAMPLERINGSIZE]; // raw ADC, first channel only
+volatile byte sampleCount = 0; // samples taken, wraps
+volatile byte sampleChannel = 0; // index the next conversion is for
+volatile byte sampleBusyMax = 0; // most Timer2 ticks ISR(ADC_vect) ended at
+volatile word thresholdRaw = 0; // last thresholdPin conversion
+volatile boolean thresholdWanted = false; // convert thresholdPin next
+#ifdef LOWPOWER
+volatile byte sampleWanted = 0; // samples left in this window
+volatile boolean sampleFinished = false; // window over, see sampleDone()
+unsigned long sampleWindows = 0; // sampleStart() calls, for powerStatus()
+#endif // LOWPOWER
+// Only touched by ISR(ADC_vect), or with interrupts off
+sampleState_t sampleState[SENSECHANNELS];
+
+byte sampleMux(byte channel) {
+    return (DEFAULT << 6) | (currentSensePins[channel] - A0);
+}
+
+ISR(TIMER2_COMPA_vect) {
+    // exactly SAMPLERATE, however busy loop() is
+    ADCSRA |= _BV(ADSC);
+}
+
+#ifdef LOWPOWER
+void sampleStop(void) {
+    // ADC and Timer2 off until the next sampleStart(), ISR context
+    TIMSK2 = 0;
+    ADCSRA = 0; // must be disabled before its clock is
+    power_adc_disable();
+    power_timer2_disable();
+    sampleFinished = true;
+}
+#endif // LOWPOWER
+
+ISR(ADC_vect) {
+    int sample = ADC;
+    byte channel = sampleChannel;
+    sampleState_t *state = &sampleState[channel];
+
+    if ((ADMUX & 0x07) == (thresholdPin - A0)) {
+        // threshold pot squeezed in after a sample, back to current sense
+        thresholdRaw = sample;
+        thresholdWanted = false;
+        ADMUX = sampleMux(channel);
+#ifdef LOWPOWER
+        if (sampleWanted == 0) {
+            sampleStop();
+        }
+#endif // LOWPOWER
+        return;
+    }
+
+    // the next Timer2 match converts the next channel
+    sampleChannel = (channel + 1 < SENSECHANNELS) ? channel + 1 : 0;
+    ADMUX = sampleMux(sampleChannel);
+
+    if (channel == 0) {
+        sampleRing[sampleCount & (SAMPLERINGSIZE - 1)] = sample;
+        sampleCount++;
+    }
+#ifdef LOWPOWER
+    if (sampleWanted > 0) {
+        sampleWanted--;
+    }
+#endif // LOWPOWER
+
+    rmsSample(&state->rms, sample, SAMPLESPERWAVE);
+    sample -= SAMPLECENTER;
+    goertzelSample(&state->goertzel, sample);
+    if (sample > state->buildHigh) {
+        state->buildHigh = sample;
+    }
+    if (sample < state->buildLow) {
+        state->buildLow = sample;
+    }
+
+    if (thresholdWanted) { // ~104us, well before the next timer tick
+        ADMUX = (DEFAULT << 6) | (thresholdPin - A0);
+        ADCSRA |= _BV(ADSC);
+    }
+#ifdef LOWPOWER
+    else if (sampleWanted == 0) {
+        sampleStop();
+    }
+#endif // LOWPOWER
+    // Timer2 restarted as the conversion began, so this is ISR time too
+    if (TCNT2 > sampleBusyMax) {
+        sampleBusyMax = TCNT2;
+    }
+}
+
+void setupSampler(void) {
+    DIDR0 = _BV(thresholdPin - A0);
+    for (byte channel=0; channel < SENSECHANNELS; channel++) {
+        sampleState[channel].buildHigh = -SAMPLECENTER;
+        sampleState[channel].buildLow = SAMPLECENTER;
+        rmsReset(&sampleState[channel].rms, SAMPLECENTER);
+        goertzelReset(&sampleState[channel].goertzel);
+        // analog inputs only, their digital input buffers just draw current
+        DIDR0 |= _BV(currentSensePins[channel] - A0);
+    }
+    sampleChannel = 0;
+    ADMUX = sampleMux(0);
+    // enabled, interrupt on completion, clk/128 (125kHz, ~104us)
+    ADCSRA = _BV(ADEN) | _BV(ADIE) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+    // CTC mode, clk/128, OCR2A sets the sample period
+    TCCR2A = _BV(WGM21);
+    TCCR2B = _BV(CS22) | _BV(CS20);
+    OCR2A = SAMPLETIMERTOP;
+#ifdef LOWPOWER
+    sampleStop(); // until sampleStart()
+    sampleFinished = false;
+#else
+    TIMSK2 = _BV(OCIE2A);
+#endif // LOWPOWER
+}
+
+#ifdef LOWPOWER
+void sampleStart(void) {
+    // power up for SAMPLEWINDOW samples a channel, Goertzel blocks from
+    // scratch
+    if (sampleWanted > 0) {
+        return; // still going
+    }
+    noInterrupts();
+    power_adc_enable();
+    power_timer2_enable();
+    ADCSRA = _BV(ADEN) | _BV(ADIE) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+    // block and cycle boundaries restart with the window, DC level stays
+    for (byte channel=0; channel < SENSECHANNELS; channel++) {
+        sampleState_t *state = &sampleState[channel];
+
+        memset(&state->goertzel.s1, 0, sizeof(state->goertzel.s1));
+        memset(&state->goertzel.s2, 0, sizeof(state->goertzel.s2));
+        state->goertzel.count = 0;
+        state->rms.cycleSquares = 0;
+        state->rms.cycleCount = 0;
+    }
+    sampleChannel = 0;
+    ADMUX = sampleMux(0);
+    sampleWanted = SAMPLEWINDOW * SENSECHANNELS;
+    sampleFinished = false;
+    sampleWindows++;
+    TCNT2 = 0;
+    TIFR2 = _BV(OCF2A); // drop a match left from before sampleStop()
+    TIMSK2 = _BV(OCIE2A);
+    interrupts();
+}
+
+boolean sampleDone(void) {
+    // true once per finished window
+    boolean result = false;
+
+    noInterrupts();
+    result = sampleFinished;
+    sampleFinished = false;
+    interrupts();
+    return result;
+}
+#endif // LOWPOWER
+
+boolean readSampleWindow(byte channel, sampleWindow_t *window) {
+    // take everything since the last call, false until a cycle finished
+    sampleState_t *state = &sampleState[channel];
+    boolean result = false;
+
+    noInterrupts();
+    if (state->rms.cycles > 0) {
+        window->high = state->buildHigh;
+        window->low = state->buildLow;
+        window->meanSquares = state->rms.meanSquares;
+        window->cycles = state->rms.cycles;
+        window->dcLevel = state->rms.dcLevel;
+        window->tonePower = state->goertzel.power;
+        state->buildHigh = -SAMPLECENTER;
+        state->buildLow = SAMPLECENTER;
+        state->rms.meanSquares = 0;
+        state->rms.cycles = 0;
+        result = true;
+    }
+    interrupts();
+    return result;
+}
+
+word readThreshold(void) {
+    // last thresholdPin conversion, and ask for a fresh one
+    word result = 0;
+
+    noInterrupts();
+    result = thresholdRaw;
+    thresholdWanted = true;
+    interrupts();
+    return result;
+}
+
+unsigned long sampleBusyCycles(void) {
+    // worst case CPU cycles in ISR(ADC_vect), to 128 cycle resolution
+    byte ticks = sampleBusyMax;
+
+    sampleBusyMax = 0;
+    if (ticks <= SAMPLEADCTICKS) {
+        return 0;
+    }
+    return (unsigned long) (ticks - SAMPLEADCTICKS) * 128;
+}
+
+void captureSamples(void) {
+    // Raw samples out as 2 bytes, 0x80 | bits 9..5 then bits 4..0, so a
+    // host can find sample boundaries anywhere in the stream.
+    static byte sent = 0; // sampleCount already sent
+    byte pending = sampleCount - sent;
+
+    if (pending > SAMPLERINGSIZE) { // loop() fell behind, ring overwritten
+        Serial.write(CAPTURELOST);
+        sent = sampleCount - SAMPLERINGSIZE;
+        pending = SAMPLERINGSIZE;
+    }
+    while (pending > 0) {
+        word sample = sampleRing[sent & (SAMPLERINGSIZE - 1)];
+
+        Serial.write(0x80 | (sample >> 5));
+        Serial.write(sample & 0x1F);
+        sent++;
+        pending--;
+    }
+}
+
+word windowRMS(const sampleWindow_t *window) {
+    // Q(RMSFRACTION) AC RMS over the window's whole cycles
+    return rmsResult(window->meanSquares, window->cycles);
+}
+
+word windowTone(const sampleWindow_t *window) {
+    // Q(RMSFRACTION) RMS of ACHERTZ and harmonics, latest block only
+    return goertzelRMS(window->tonePower);
+}
+
+int windowDC(const sampleWindow_t *window) {
+    // Q(RMSFRACTION) offset of the tracked 0 amp level from SAMPLECENTER
+    return (window->dcLevel >> RMSDCSHIFT) - (SAMPLECENTER << RMSFRACTION);
+}
+
+#endif // SAMPLER_H
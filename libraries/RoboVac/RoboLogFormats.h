@@ -0,0 +1,28 @@
+/*
+  Log record formats for the RoboVac deferred logger
+
+  Only the ID and argument count are compiled into the firmware, the text
+  is read from this file by robolog.py on the host when decoding.  Text
+  uses printf conversions, plus %S to print a vacstate_t by name.
+  Append new formats at the end so older captures still decode.
+
+  LOGFORMAT(ID, ARGC, TEXT)
+*/
+
+LOGFORMAT(LOG_DROPPED, 1, "Log ring full, %lu record(s) dropped")
+LOGFORMAT(LOG_MESSAGE, 5, "Message: Magic: 0x%lX Version: %lu node ID: %lu Uptime: %lums Sig. Stren: %ld")
+LOGFORMAT(LOG_BADMESSAGE, 4, "Rejected node_id %lu: CRC ok: %lu valid: %lu known node: %lu")
+LOGFORMAT(LOG_STATECHANGE, 2, "State Change: %S -> %S")
+LOGFORMAT(LOG_COMPETING, 2, "Warning: Node %lu waiting, MAXOPENPORTS in use (top node %lu)")
+LOGFORMAT(LOG_PORTSMOVE, 3, "Moving ports 0x%lX (bit per port) in %lu I2C burst(s), done in %lums")
+LOGFORMAT(LOG_COUNTCLIPPED, 2, "Clipped node_id %lu receive_count to %lu")
+LOGFORMAT(LOG_COUNTREDUCED, 2, "Reduced node_id %lu receive_count by %lu")
+LOGFORMAT(LOG_COUNTZEROED, 1, "Reduced node_id %lu receive_count to 0")
+LOGFORMAT(LOG_HEARDZEROED, 1, "Clipped node_id %lu last_heard to 0")
+LOGFORMAT(LOG_OVERRIDEINC, 1, "Override +: %lu")
+LOGFORMAT(LOG_OVERRIDESTART, 1, "Override by: %lu")
+LOGFORMAT(LOG_SENSESTATUS, 5, "Channel %lu  threshold: %ld/8  SampleHigh: %ld  SampleLow: %ld  Override: %lu")
+LOGFORMAT(LOG_SENSERMS, 2, "SampleRMS: %lu/8  SampleDC: %ld/8")
+LOGFORMAT(LOG_SENSETONE, 1, "SampleTone: %lu/8")
+LOGFORMAT(LOG_SENSEBUSY, 1, "Sample ISR: at most %lu cycles")
+LOGFORMAT(LOG_SENSEPOWER, 4, "Power: ~%luuA  Awake: %lu/1000  ADC: %lu/1000  TX: %lu/1000")
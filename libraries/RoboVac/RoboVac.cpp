@@ -21,11 +21,12 @@
 #include <Arduino.h>
 #include <RoboVac.h>
 
-void makeMessage(message_t *message, byte nodeID) {
+void makeMessage(message_t *message, byte nodeID, byte channels) {
     message->magic = MESSAGEMAGIC;
     message->version = MESSAGEVERSION;
     message->node_id = nodeID;
     message->up_time = millis();
+    message->channels = channels;
 }
 
 void copyMessage(message_t *destination, const message_t *source) {
@@ -33,11 +34,13 @@ void copyMessage(message_t *destination, const message_t *source) {
     destination->version = source->version;
     destination->node_id = source->node_id;
     destination->up_time = source->up_time;
+    destination->channels = source->channels;
 }
 
 boolean validMessage(const message_t *message) {
     if (     (message->magic == MESSAGEMAGIC) &&
-             (message->version == MESSAGEVERSION) &&
+             ((message->version == MESSAGEVERSION) ||
+              (message->version == 0x01)) &&
              (message->node_id > 0) &&
              (message->node_id < 255) ) {
         return true;
@@ -45,3 +48,103 @@ boolean validMessage(const message_t *message) {
         return false;
     }
 }
+
+byte messageChannels(const message_t *message) {
+    // version 0x01 frames end before channels, those nodes sense one
+    if (message->version == 0x01) {
+        return 0x01;
+    }
+    return message->channels;
+}
+
+word isqrt(unsigned long value) {
+    // integer square root, one result bit per pass
+    unsigned long result = 0;
+    unsigned long bit = 1UL << 30;
+
+    while (bit > value) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (value >= result + bit) {
+            value -= result + bit;
+            result = (result >> 1) + bit;
+        } else {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+    return result;
+}
+
+static byte logRing[LOGRINGSIZE];
+static byte logHead = 0; // next byte to store
+static byte logTail = 0; // next byte to send
+static unsigned long logDropped = 0; // records lost to a full ring
+static unsigned long logLastDrain = 0; // millis() of last send
+
+static byte logFree(void) {
+    return (LOGRINGSIZE - 1) - ((logHead - logTail) & (LOGRINGSIZE - 1));
+}
+
+static void logPut(byte value) {
+    logRing[logHead] = value;
+    logHead = (logHead + 1) & (LOGRINGSIZE - 1);
+}
+
+static void logPutLong(unsigned long value) {
+    for (byte count=0; count < 4; count++) {
+        logPut(value & 0xFF);
+        value >>= 8;
+    }
+}
+
+void logRecord(byte format, byte argc,
+               long arg0, long arg1, long arg2, long arg3, long arg4) {
+    // Queue a record, never blocks. Records that don't fit are counted
+    // and reported by a LOG_DROPPED record once there is room again.
+    long args[LOGMAXARGS] = { arg0, arg1, arg2, arg3, arg4 };
+    byte size = 7 + (4 * argc);
+
+    if (logDropped > 0) {
+        if (logFree() < (size + 11)) { // 11 == LOG_DROPPED record size
+            logDropped++;
+            return;
+        }
+        logPut(LOGSYNC);
+        logPut(LOG_DROPPED);
+        logPut(1);
+        logPutLong(millis());
+        logPutLong(logDropped);
+        logDropped = 0;
+    } else if (logFree() < size) {
+        logDropped++;
+        return;
+    }
+
+    logPut(LOGSYNC);
+    logPut(format);
+    logPut(argc);
+    logPutLong(millis());
+    for (byte arg=0; arg < argc; arg++) {
+        logPutLong(args[arg]);
+    }
+}
+
+void logDrain(void) {
+    // Only hand Serial as many bytes as the UART sent since the last call
+    // so Serial.write() never waits for room in its transmit buffer.
+    unsigned long elapsed = min(millis() - logLastDrain, 1000UL);
+    unsigned int budget = (elapsed * (SERIALBAUD / 10)) / 1000;
+
+    if (budget == 0) {
+        return; // let the fraction of a byte add up
+    }
+    logLastDrain = millis();
+    budget = min(budget, (unsigned int) LOGDRAINMAX);
+    while ((budget > 0) && (logTail != logHead)) {
+        Serial.write(logRing[logTail]);
+        logTail = (logTail + 1) & (LOGRINGSIZE - 1);
+        budget--;
+    }
+}
@@ -25,12 +25,15 @@
 
 // Definitions
 #define MESSAGEMAGIC 0x9876
-#define MESSAGEVERSION 0x01
+#define MESSAGEVERSION 0x02 // 0x01 had no channels, see messageChannels()
 #define MESSAGESIZE sizeof(message_t)
+#ifndef TXINTERVAL // robovac/sim/sweep.py may override it
 #define TXINTERVAL 1002 // Miliseconds between transmits
+#endif
 #define RXTXBAUD 300 // Rf Baud
 #define SERIALBAUD 9600
 #define NODENAMEMAX 27 // name characters + 1
+#define MAXCHANNELS 8 // sensing channels per node, bits in message_t channels
 
 // Macros
 #define STATE2CASE(STATE) case STATE: stateStr = #STATE; break;
@@ -58,54 +61,83 @@
 #define D(...) {;;}
 #endif // DEBUG
 
-#ifdef DEBUG
-#define PRINTTIME(MILLIS) {\
-    int seconds = (MILLIS / 1000);\
-    int millisec = MILLIS % 1000;\
-    int minutes = seconds / 60;\
-    seconds = seconds % 60;\
-    int hours = minutes / 60;\
-    minutes = minutes % 60;\
-    int days = hours / 24;\
-    hours = hours % 24;\
-    \
-    D(days); D(":");\
-    D(hours); D(":");\
-    D(minutes); D(":");\
-    D(seconds); D(" (");\
-    D(MILLIS); D(") ");\
-}
-#else
-#define PRINTTIME(CURRENTTIME) {;;}
-#endif // DEBUG
+// Deferred logging: call sites store a small binary record in a RAM ring
+// which logDrain() trickles out over Serial at the rate the UART sends.
+// Record: LOGSYNC, format, argc, millis() (4 bytes), argc * 4 byte args,
+// all little-endian. Decode with robolog.py, text mixed in passes through.
+#define LOGSYNC 0xA5 // starts each record, never part of printed text
+#define LOGRINGSIZE 128 // bytes of SRAM for queued records (power of two)
+#define LOGDRAINMAX 32 // most bytes handed to Serial per logDrain()
+#define LOGMAXARGS 5
+
+#define LOGFORMAT(ID, ARGC, TEXT) ID,
+typedef enum logFormat_e {
+#include "RoboLogFormats.h"
+    LOG_ENDFORMAT
+} logFormat_t;
+#undef LOGFORMAT
 
 #ifdef DEBUG
-#define PRINTMESSAGE(CURRENTTIME, MESSAGE, SIGSTREN) {\
-    PRINTTIME(CURRENTTIME);\
-    D("Message:");\
-    D(" Magic: 0x"); D(message.magic, HEX);\
-    D(" Version: "); D(message.version);\
-    D(" node ID: "); D(message.node_id);\
-    D(" Uptime: ");\
-    D(message.up_time); D("ms ");\
-    D("Sig. Stren: "); D(SIGSTREN);\
-    D("\n");\
-}
+#define LOG0(FORMAT) logRecord(FORMAT, 0, 0, 0, 0, 0, 0)
+#define LOG1(FORMAT, A) logRecord(FORMAT, 1, (long) (A), 0, 0, 0, 0)
+#define LOG2(FORMAT, A, B) logRecord(FORMAT, 2, (long) (A), (long) (B),\
+                                     0, 0, 0)
+#define LOG3(FORMAT, A, B, C) logRecord(FORMAT, 3, (long) (A), (long) (B),\
+                                        (long) (C), 0, 0)
+#define LOG4(FORMAT, A, B, C, E) logRecord(FORMAT, 4, (long) (A), (long) (B),\
+                                           (long) (C), (long) (E), 0)
+#define LOG5(FORMAT, A, B, C, E, F) logRecord(FORMAT, 5, (long) (A),\
+                                              (long) (B), (long) (C),\
+                                              (long) (E), (long) (F))
+#define LOGDRAIN() logDrain()
 #else
-#define PRINTMESSAGE(CURRENTTIME, MESSAGE, SIGSTREN) {;;}
+#define LOG0(...) {;;}
+#define LOG1(...) {;;}
+#define LOG2(...) {;;}
+#define LOG3(...) {;;}
+#define LOG4(...) {;;}
+#define LOG5(...) {;;}
+#define LOGDRAIN() {;;}
 #endif // DEBUG
 
+#define PRINTMESSAGE(MESSAGE, SIGSTREN) LOG5(LOG_MESSAGE,\
+    (MESSAGE).magic, (MESSAGE).version, (MESSAGE).node_id,\
+    (MESSAGE).up_time, SIGSTREN)
+
 typedef struct nodeInfo_s {
+    // Hot fields only, kept in SRAM (no padding on AVR). Servo limits
+    // and name stay cold in the EEPROM nodeRecord_t, see readNodeRecord()
+    unsigned long last_heard; // timestamp last message was received
     byte node_id; // node ID
     byte port_id; // servo node_id is mapped to
-    word servo_min; // minimum limit of travel in 4096ths of 60hz PWM(?)
-    word servo_max; // maximum limit of travel
+    byte channel; // node_id's sensing channel 1..MAXCHANNELS, 0 == any
     unsigned char receive_count; // number of messages received in THRESHOLD
     unsigned char new_count; // messages just received
-    unsigned long last_heard; // timestamp last message was received
-    char node_name[NODENAMEMAX]; // name of the node
 } nodeInfo_t;
 
+// Cold per-node configuration, only kept in EEPROM
+#define NODESTOREMAGIC 0x5256 // "RV"
+#define NODESTOREVERSION 0x04 // increment when nodeRecord_t changes
+#define NODESTOREOLDEST 0x01 // oldest version readOldNodeRecord() converts
+
+typedef struct nodeStoreHeader_s {
+    word magic; // NODESTOREMAGIC when EEPROM was written by this layout
+    byte version; // NODESTOREVERSION
+    byte count; // number of nodeRecord_t following
+} nodeStoreHeader_t;
+
+typedef struct nodeRecord_s {
+    // New fields go at the end, before crc, see readOldNodeRecord()
+    byte node_id; // node ID
+    byte port_id; // servo node_id is mapped to
+    word servo_min; // minimum limit of travel in 4096ths of 60hz PWM
+    word servo_max; // maximum limit of travel
+    char node_name[NODENAMEMAX-1]; // name, '\0' padded, terminator not stored
+    byte priority; // higher opens first when over MAXOPENPORTS (version 2)
+    byte channel; // node_id's sensing channel 1..MAXCHANNELS, 0 == any (3)
+    word crc; // _crc16_update() over all of the above
+} nodeRecord_t;
+
 typedef enum vacstate_e {
     VAC_LISTENING, // Waiting for Signal
     VAC_VACPOWERUP, // Powering up vacuum
@@ -134,12 +166,22 @@ typedef struct message_s {
     byte version; // protocol version
     byte node_id; // node ID
     unsigned long up_time; // number of miliseconds running
+    byte channels; // bit (channel - 1) set while that channel is breached
 } message_t;
 
-void makeMessage(message_t *message, byte nodeID);
+void makeMessage(message_t *message, byte nodeID, byte channels);
 
 void copyMessage(message_t *destination, const message_t *source);
 
 boolean validMessage(const message_t *message);
 
+byte messageChannels(const message_t *message);
+
+word isqrt(unsigned long value);
+
+void logRecord(byte format, byte argc,
+               long arg0, long arg1, long arg2, long arg3, long arg4);
+
+void logDrain(void);
+
 #endif // ROBOVAC_H
@@ -0,0 +1,127 @@
+#!/usr/bin/env python
+
+"""
+Decode RoboVac deferred log records back into text
+
+    robolog.py [serial device [baud]] < capture
+
+Reads a serial device (needs pyserial) or stdin.  Plain text, such as the
+setup() banner, is passed through as-is.  Format text and state names are
+taken from RoboLogFormats.h and RoboVac.h next to this script.
+"""
+
+import os
+import re
+import struct
+import sys
+
+LOGSYNC = 0xA5
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+
+def load_formats():
+    formats = []
+    pattern = re.compile(r'^LOGFORMAT\((\w+),\s*(\d+),\s*"(.*)"\)', re.M)
+    source = open(os.path.join(HERE, "RoboLogFormats.h")).read()
+    for name, argc, text in pattern.findall(source):
+        formats.append((name, int(argc), text))
+    return formats
+
+
+def load_max_args():
+    source = open(os.path.join(HERE, "RoboVac.h")).read()
+    return int(re.search(r'^#define LOGMAXARGS (\d+)', source, re.M).group(1))
+
+
+def load_states():
+    source = open(os.path.join(HERE, "RoboVac.h")).read()
+    body = re.search(r'typedef enum vacstate_e \{(.*?)\}', source, re.S)
+    return re.findall(r'^\s*(VAC_\w+)', body.group(1), re.M)
+
+
+def format_time(millis):
+    # Same layout PRINTTIME used: days:hours:minutes:seconds (millis)
+    seconds, minutes = millis // 1000, millis // 60000
+    return "%d:%d:%d:%d (%d) " % (minutes // 1440, (minutes // 60) % 24,
+                                  minutes % 60, seconds % 60, millis)
+
+
+def format_record(formats, states, fmt, millis, args):
+    if fmt >= len(formats):
+        return "%sUnknown log format %d %r" % (format_time(millis), fmt, args)
+    text = formats[fmt][2]
+    values = iter(args)
+
+    def convert(match):
+        spec, kind = match.group(1), match.group(2)
+        value = next(values, 0)
+        if kind == 'S':
+            if 0 <= value < len(states):
+                return states[value]
+            return "MISSING STATE!!!"
+        if kind in 'uxX':
+            value &= 0xFFFFFFFF
+        return ('%' + spec + kind.replace('u', 'd')) % value
+
+    return format_time(millis) + re.sub(r'%([-0-9]*)l?([duxXS])',
+                                        convert, text)
+
+
+class Reader(object):
+    # stream with bytes pushed back, for rescanning after a bad record
+
+    def __init__(self, stream):
+        self.stream = stream
+        self.pending = b""
+
+    def read_exact(self, count):
+        data, self.pending = self.pending[:count], self.pending[count:]
+        while len(data) < count:
+            more = self.stream.read(count - len(data))
+            if not more:
+                raise EOFError()
+            data += more
+        return data
+
+    def unread(self, data):
+        self.pending = data + self.pending
+
+
+def decode(stream, out=sys.stdout):
+    formats = load_formats()
+    states = load_states()
+    max_args = load_max_args()
+    reader = Reader(stream)
+    synced = True  # False after a bad record, until the next LOGSYNC
+    while True:
+        try:
+            byte = reader.read_exact(1)
+            if ord(byte) != LOGSYNC:
+                if synced:
+                    out.write(byte.decode('ascii', 'replace'))
+                continue
+            header = reader.read_exact(2)
+            fmt, argc = struct.unpack("<BB", header)
+            if fmt >= len(formats) or argc > max_args:
+                # LOGSYNC inside another record's bytes, attached
+                # mid-stream or a byte was lost.  Rescan what followed it.
+                reader.unread(header)
+                synced = False
+                continue
+            synced = True
+            millis, = struct.unpack("<L", reader.read_exact(4))
+            args = struct.unpack("<%dl" % argc,
+                                 reader.read_exact(4 * argc))
+        except EOFError:
+            break
+        out.write(format_record(formats, states, fmt, millis, args) + "\n")
+        out.flush()
+
+
+if __name__ == "__main__":
+    if len(sys.argv) > 1:
+        import serial
+        baud = int(sys.argv[2]) if len(sys.argv) > 2 else 9600
+        decode(serial.Serial(sys.argv[1], baud))
+    else:
+        decode(getattr(sys.stdin, 'buffer', sys.stdin))
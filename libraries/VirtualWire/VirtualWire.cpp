@@ -110,6 +110,9 @@ static uint8_t vw_rx_bad = 0;
 // Number of good messages received
 static uint8_t vw_rx_good = 0;
 
+// Called at interrupt level when vw_rx_done is set, NULL for none
+static void (*vw_rx_done_hook)() = NULL;
+
 // 4 bit to 6 bit symbol converter table
 // Used to convert the high and low nybbles of the transmitted data
 // into 6 bit symbols for transmission. Each 6-bit symbol has 3 1s and 3 0s 
@@ -165,6 +168,12 @@ void vw_set_ptt_pin(uint8_t pin)
     vw_ptt_pin = pin;
 }
 
+// Set the function called at interrupt level when a message completes
+void vw_set_rx_done_hook(void (*hook)())
+{
+    vw_rx_done_hook = hook;
+}
+
 // Set the ptt pin inverted (low to transmit)
 void vw_set_ptt_inverted(uint8_t inverted)
 {
@@ -247,6 +256,8 @@ void vw_pll()
 		    vw_rx_active = false;
 		    vw_rx_good++;
 		    vw_rx_done = true; // Better come get it before the next one starts
+		    if (vw_rx_done_hook)
+			vw_rx_done_hook();
 		}
 		vw_rx_bit_count = 0;
 	    }
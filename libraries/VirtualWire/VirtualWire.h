@@ -219,6 +219,14 @@ extern "C"
     /// \param[in] inverted True to invert PTT
     extern void vw_set_ptt_inverted(uint8_t inverted);
 
+    /// Set a function to call as soon as a complete message is received,
+    /// instead of polling vw_have_message().
+    /// The hook runs at interrupt level from the timer ISR, so it must be
+    /// short and should only set a flag or start a conversion. Read the
+    /// message with vw_get_message() later, at user level.
+    /// \param[in] hook Function to call, or NULL to disable
+    extern void vw_set_rx_done_hook(void (*hook)());
+
     /// Initialise the VirtualWire software, to operate at speed bits per second
     /// Call this one in your setup() after any vw_set_* calls
     /// Must call vw_rx_start() before you will get any messages
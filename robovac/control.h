@@ -13,35 +13,21 @@ void vacControl(boolean turnOn) {
     if (turnOn == true) {
         digitalWrite(vacPowerControlPin, HIGH);
     } else {
-        digitalWrite(servoPowerControlPin, LOW);
+        digitalWrite(vacPowerControlPin, LOW);
     }
 }
 
-void moveServos(unsigned char port_id) {
-    // will be called repeatidly until SERVOMOVETIME expires
-    // port_id could change on any call
-    int nodeCount=0;
+void moveServos(word portMask, unsigned long currentTime) {
+    // will be called repeatidly until portsArrived()
+    // portMask could change on any call, only changes hit the I2C bus
+    byte bursts = 0;
 
-    PRINTTIME(millis());
-    if (port_id == 0) {
-        D("Opening all port doors");
-    } else { // Close all ports except port_id
-        for (nodeCount=0; nodeCount < MAXNODES; nodeCount++) {
-            if (nodeInfo[nodeCount].port_id != port_id) {
-                D("Closing node_id ");
-                D(nodeInfo[nodeCount].node_id);
-                D("'s port ");
-                D(nodeInfo[nodeCount].port_id);
-            } else {
-                D("Leaving node_id ");
-                D(nodeInfo[nodeCount].node_id);
-                D("'s port ");
-                D(nodeInfo[nodeCount].port_id);
-                D(" open!!!!!!!!");
-            }
-        }
+    computePorts(portMask, currentTime);
+    updatePorts(currentTime);
+    bursts = writePorts();
+    if (bursts > 0) {
+        LOG3(LOG_PORTSMOVE, portMask, bursts, portsArrive - currentTime);
     }
-    D("\n");
 }
 
 #endif // CONTROL_H
@@ -5,43 +5,56 @@
 void robovacStateEvent(TimerInformation *Sender) {
     unsigned long currentTime = millis();
 
+    updateNodes(currentTime);
     handleActionState(currentTime);
 }
 
-void pollRxEvent(TimerInformation *Sender) {
+void rxDone(void) {
+    // VirtualWire calls this at interrupt level as a frame completes.
+    // The carrier is still up, so start the RSSI conversion right now.
+    ADMUX = (DEFAULT << 6) | (signalStrengthPin & 0x07);
+    ADCSRA |= _BV(ADSC);
+    rxPending = true;
+}
+
+void handleRx(void) {
     boolean CRCGood = false;
     uint8_t buffLen = sizeof(message_t);
     uint8_t *messageBuff = (uint8_t *) &message;
     unsigned long currentTime = millis();
+    word nodes = 0; // nodeInfo indexes the message is for
 
-    signalStrength = analogRead(signalStrengthPin);
+    rxPending = false;
+    while (bit_is_set(ADCSRA, ADSC)) {
+        ; // ~100us conversion started by rxDone(), normally long finished
+    }
+    signalStrength = ADC;
     if (vw_have_message()) {
         digitalWrite(statusLEDPin, HIGH);
         CRCGood = vw_get_message(messageBuff, &buffLen);
+        nodes = findNodes(message.node_id, messageChannels(&message));
         if ( (CRCGood == false) || (validMessage(&message) == false)
-                                || (findNode(message.node_id) == NULL) ) {
+                                || (nodes == 0) ) {
                 blankMessage = true;
-                PRINTMESSAGE(millis(), message, signalStrength);
-                if (CRCGood == false) {
-                    D("Bad CRC ");
-                }
-                if (validMessage(&message) == false) {
-                    D("Invalid message ");
-                }
-                if (findNode(message.node_id) == NULL) {
-                    D("Invalid node_id ");
-                    D(message.node_id)
-                }
-                D("\n");
-        } else { // Good message
+                PRINTMESSAGE(message, signalStrength);
+                LOG4(LOG_BADMESSAGE, message.node_id, CRCGood,
+                     validMessage(&message), nodes != 0);
+        } else { // Good message, act on it now rather than next state tick
             blankMessage = false;
             lastReception = currentTime;
+            for (int nodeCount=0; nodeCount < MAXNODES; nodeCount++) {
+                if (nodes & bit(nodeCount)) { // one per (node, channel)
+                    nodeInfo[nodeCount].new_count++;
+                }
+            }
+            updateNodes(currentTime);
+            handleActionState(currentTime);
         }
     }
 }
 
 void statusEvent(TimerInformation *Sender) {
-    PRINTMESSAGE(millis(), message, signalStrength);
+    PRINTMESSAGE(message, signalStrength);
     digitalWrite(statusLEDPin, LOW);
 }
 
@@ -3,20 +3,39 @@
 #define GLOBALS_H
 
 /* Definitions */
-#define DEBUG // undefine to turn off all serial output
-
 // Constants used once (to save space)
-#define POLLINTERVAL 25 // @ 300 baud, takes 100ms to receive 30 bytes
-#define STATEINTERVAL (POLLINTERVAL+3) // update state almost as quickly
+#define STATEINTERVAL 28 // messages are handled as they arrive, see rxDone()
 #define LCDINTERVAL (STATEINTERVAL+32) // UI can be a bit slower
 #define STATUSINTERVAL 1015 // mainly for debugging / turning LED off
+#ifndef GOODMSGMIN // sim/sweep.py may override the #ifndef guarded values
 #define GOODMSGMIN 3 // Minimum number of good messages in...
+#endif
+#ifndef THRESHOLD
 #define THRESHOLD 10000 // ..10 second reception threshold, to signal start
-#define MAXNODES 10 // number of nodes to keep track of
+#endif
+#define MAXNODES 10 // number of nodes to keep track of, at most 16 (word mask)
 #define NODENAMEMAX 27 // name characters + 1
 #define SERVOPOWERTIME 250 // ms to wait for servo's to power up/down
-#define SERVOMOVETIME 1000 // ms to wait for servo's to move
+#define SERVOSPEED 600 // servo cruise speed in PWM counts per second
+#define SERVOACCEL 3000 // servo acceleration in PWM counts per second^2
+#define SERVOSTAGGER 40 // ms between each port starting to move
+#define SERVOSETTLETIME 50 // ms to let the slowest servo settle
 #define VACPOWERTIME 2000 // ms to wait for vac to power on
+#define MAXPORTS 16 // PCA9685 channels, port_id 1..MAXPORTS (0 == all)
+#define ALLPORTS 0xFFFF // port mask, bit (port_id - 1) set when open
+#ifndef MAXOPENPORTS
+#define MAXOPENPORTS 2 // ports open at once, limited by vac airflow
+#endif
+#define PWMI2CADDR 0x40 // PCA9685 servo board address
+#define PWMFREQ 60 // Servo PWM frame rate in Hz
+#define PORTSTAGGER (4096/MAXPORTS) // PWM counts between channel pulse starts
+#define LCDCOLS 16
+#define LCDROWS 2
+#define LCDRUNGAP 1 // unchanged cells resent rather than moving the cursor
+#define LCDMAXCELLS 8 // cells sent per lcdEvent, keeps RX polling on time
+#define LCDSPLASHTIME 2000 // ms to show the splash screen
+#define LCDSLEEPTIME 30000 // ms without buttons before backlight turns off
+#define LCDMENUITEMS 3 // Back, Port/ID Names, Monitor
 
 /* constants */
 const int statusLEDPin = 13;
@@ -29,18 +48,37 @@ const int servoCenterPW = 368;
 /* globals */
 message_t message;
 nodeInfo_t nodeInfo[MAXNODES];
-nodeInfo_t *currentActive = NULL;
-nodeInfo_t *lastActive = NULL;
+nodeInfo_t *currentActive = NULL; // highest priority active node
+word openPorts = 0; // port mask servos were last moved to
+boolean portsMoving = false; // servos powered while VAC_VACUUMING retargets
 boolean blankMessage = true; // Signal not to read from message
 unsigned long lastReception = 0; // millis() since a message was last received
 unsigned long lastStateChange = 0; // last time state was changed
 int signalStrength = 0;
+volatile boolean rxPending = false; // set at interrupt level by rxDone()
 vacstate_t actionState = VAC_SERVOPOSTPOWERUP; // make double-sure all ports open
 const char *statusMessage = "\0";
-Adafruit_PWMServoDriver pwm = Adafruit_PWMServoDriver();
+Adafruit_PWMServoDriver pwm = Adafruit_PWMServoDriver(PWMI2CADDR);
+word portPW[MAXPORTS]; // wanted pulse width per channel, 0 == not driven
+word portWritten[MAXPORTS]; // pulse width last sent to the PCA9685
+word portFrom[MAXPORTS]; // pulse width when current move started
+word portTarget[MAXPORTS]; // pulse width current move ends at
+word portDuration[MAXPORTS]; // ms current move takes
+unsigned long portStart[MAXPORTS]; // millis() current move starts
+unsigned long portsArrive = 0; // millis() slowest port finishes moving
 Adafruit_RGBLCDShield lcd = Adafruit_RGBLCDShield();
-lcdState_t lcdState;
+lcdState_t lcdState = LCD_STARTUP;
+unsigned long lastLCDStateChange = 0; // last time lcdState was changed
 uint8_t lcdButtons;
 unsigned long lastButtonChange; // last time button state changed
+char lcdShadow[LCDROWS][LCDCOLS]; // what the screen should show
+char lcdShown[LCDROWS][LCDCOLS]; // what was last sent to the screen
+byte lcdMenuItem = 0; // highlighted LCD_MENU item
+byte lcdNodeIndex = MAXNODES; // node shown in Port/ID Names, MAXNODES == none
+
+/* EEPROM */
+nodeStoreHeader_t nodeStoreHeader EEMEM;
+nodeRecord_t nodeStore[MAXNODES] EEMEM;
+boolean nodeStoreOK = false; // nodeStore is this layout, else cold defaults
 
 #endif // GLOBALS_H
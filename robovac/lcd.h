@@ -1,6 +1,162 @@
 #ifndef LCD_H
 #define LCD_H
 
+// Screens are drawn into lcdShadow, lcdFlush() sends only the cells that
+// differ from lcdShown. Every character costs several I2C transactions
+// through the shield's MCP23017, so unchanged cells are never resent.
 
+void lcdInvalidate(void) {
+    // force every cell to be resent, e.g. after lcd.begin()
+    memset(lcdShown, 0, sizeof(lcdShown));
+}
+
+void lcdBlank(void) {
+    memset(lcdShadow, ' ', sizeof(lcdShadow));
+}
+
+void lcdText(byte col, byte row, const char *text) {
+    // copy text into the shadow, clipped at the end of the row
+    while ((*text != '\0') && (col < LCDCOLS)) {
+        lcdShadow[row][col] = *text;
+        text++;
+        col++;
+    }
+}
+
+void lcdNumber(byte col, byte row, unsigned long value, byte width) {
+    // right aligned, zero padded to width digits
+    while (width > 0) {
+        width--;
+        if ((col + width) < LCDCOLS) {
+            lcdShadow[row][col + width] = '0' + (value % 10);
+        }
+        value /= 10;
+    }
+}
+
+void lcdNodeID(byte col, byte row, const nodeInfo_t *node) {
+    // "ID#000.1", the channel left off when the entry takes any
+    lcdText(col, row, "ID#");
+    lcdNumber(col + 3, row, node->node_id, 3);
+    if (node->channel != 0) {
+        lcdText(col + 6, row, ".");
+        lcdNumber(col + 7, row, node->channel, 1);
+    }
+}
+
+byte lcdFlush(void) {
+    // Send changed cells, up to LCDMAXCELLS per call, return cells sent.
+    // Changes at most LCDRUNGAP cells apart share one cursor+write run.
+    byte sent = 0;
+
+    for (byte row=0; row < LCDROWS; row++) {
+        byte col = 0;
+
+        while ((col < LCDCOLS) && (sent < LCDMAXCELLS)) {
+            byte runEnd = col;
+            byte gap = 0;
+
+            if (lcdShadow[row][col] == lcdShown[row][col]) {
+                col++;
+                continue;
+            }
+            // extend the run while the next change is close enough
+            for (byte next=col + 1; next < LCDCOLS; next++) {
+                if (lcdShadow[row][next] != lcdShown[row][next]) {
+                    runEnd = next;
+                    gap = 0;
+                } else if (++gap > LCDRUNGAP) {
+                    break;
+                }
+            }
+            lcd.setCursor(col, row);
+            while ((col <= runEnd) && (sent < LCDMAXCELLS)) {
+                lcd.write(lcdShadow[row][col]);
+                lcdShown[row][col] = lcdShadow[row][col];
+                col++;
+                sent++;
+            }
+        }
+    }
+    return sent;
+}
+
+void lcdBacklight(boolean turnOn) {
+    static boolean isOn = false;
+
+    if (turnOn != isOn) { // backlight is another I2C write, skip repeats
+        lcd.setBacklight(turnOn ? 0x1 : 0x0);
+        isOn = turnOn;
+    }
+}
+
+void lcdSplashScreen(void) {
+    lcdBlank();
+    lcdText(1, 0, "RoboVac v0.0.0");
+    lcdText(3, 1, "> Menu <");
+}
+
+void lcdMonitorScreen(unsigned long currentTime) {
+    // |LISTENING       |
+    // |Sig:0000 Rx:0000|
+    const char *stateStr;
+
+    lcdBlank();
+    STATE2STRING(actionState);
+    lcdText(0, 0, stateStr + 4); // skip "VAC_"
+    lcdText(0, 1, "Sig:");
+    lcdNumber(4, 1, signalStrength, 4);
+    lcdText(9, 1, "Rx:");
+    if (lastReception == 0) {
+        lcdText(12, 1, "----");
+    } else { // seconds since last good message
+        lcdNumber(12, 1, min((currentTime - lastReception) / 1000, 9999UL), 4);
+    }
+}
+
+void lcdRunningScreen(unsigned long currentTime) {
+    // |PORT00MAPNAME?  |
+    // |Port#00 ID#000.1|
+    char node_name[NODENAMEMAX];
+
+    if (currentActive == NULL) { // shutting down
+        lcdMonitorScreen(currentTime);
+        return;
+    }
+    lcdBlank();
+    readNodeName(currentActive - nodeInfo, node_name); // cold, from EEPROM
+    lcdText(0, 0, node_name);
+    lcdText(0, 1, "Port#");
+    lcdNumber(5, 1, currentActive->port_id, 2);
+    lcdNodeID(8, 1, currentActive);
+}
+
+void lcdMenuScreen(void) {
+    // |>Port/ID Names  |
+    // | Monitor        |
+    static const char *items[LCDMENUITEMS] = { "Back",
+                                               "Port/ID Names",
+                                               "Monitor" };
+    byte top = min(lcdMenuItem, (byte) (LCDMENUITEMS - LCDROWS));
+
+    lcdBlank();
+    for (byte row=0; row < LCDROWS; row++) {
+        lcdText(0, row, (top + row) == lcdMenuItem ? ">" : " ");
+        lcdText(1, row, items[top + row]);
+    }
+}
+
+void lcdNodeScreen(void) {
+    // |Port#00 ID#000.1|
+    // |PORT00MAPNAME?  |
+    char node_name[NODENAMEMAX];
+
+    lcdBlank();
+    lcdText(0, 0, "Port#");
+    lcdNumber(5, 0, nodeInfo[lcdNodeIndex].port_id, 2);
+    lcdNodeID(8, 0, &nodeInfo[lcdNodeIndex]);
+    readNodeName(lcdNodeIndex, node_name); // cold, from EEPROM
+    lcdText(0, 1, node_name);
+}
 
 #endif // LCD_H
@@ -1,86 +1,143 @@
 #ifndef NODEINFO_H
 #define NODEINFO_H
 
+unsigned char decayedCount(const nodeInfo_t *node, unsigned long currentTime) {
+    // receive_count less one for every (THRESHOLD/GOODMSGMIN) since last heard
+    unsigned long expired_count = 0;
+
+    if (node->last_heard == 0) {
+        return 0;
+    }
+    expired_count = (currentTime - node->last_heard) / (THRESHOLD/GOODMSGMIN);
+    if (expired_count >= node->receive_count) {
+        return 0;
+    }
+    return node->receive_count - expired_count;
+}
+
 void updateNodes(unsigned long currentTime) {
-    // keep receive_count updated for all nodes
+    // fold new_count into receive_count, expire nodes no longer heard
+    unsigned char max_count = THRESHOLD/TXINTERVAL;
 
-    // for each node, update receive_count by new_count w/in THRESHOLD
     for (int nodeCount=0; nodeCount < MAXNODES; nodeCount++) {
-        unsigned long elapsedTime = currentTime - nodeInfo[nodeCount].last_heard;
-        unsigned char max_count = THRESHOLD/TXINTERVAL;
-        unsigned char expired_count = elapsedTime % (THRESHOLD/GOODMSGMIN);
-
-        // increase rate is capped by max transmit rate during threshold
-        nodeInfo[nodeCount].receive_count += nodeInfo[nodeCount].new_count;
-        if (nodeInfo[nodeCount].receive_count > max_count) {
-            nodeInfo[nodeCount].receive_count = max_count;
-            PRINTTIME(currentTime);
-            D("Clipped node_id "); D(nodeInfo[nodeCount].node_id);
-            D(" receive_count to "); D(max_count);
-            D("^@");
-        }
+        nodeInfo_t *node = &nodeInfo[nodeCount];
+        unsigned char count = decayedCount(node, currentTime);
 
-        // for every (THRESHOLD/GOODMSGMIN) over, reduce count by one
-        if (nodeInfo[nodeCount].receive_count > expired_count) {
-            nodeInfo[nodeCount].receive_count -= expired_count;
-            PRINTTIME(currentTime);
-            D("Reduced node_id "); D(nodeInfo[nodeCount].node_id);
-            D(" receive_count by "); D(expired_count);
-            D("^@");
-
-        } else {
-            nodeInfo[nodeCount].receive_count = 0; // expired_count was bigger
-            PRINTTIME(currentTime);
-            D("Reduced node_id "); D(nodeInfo[nodeCount].node_id);
-            D(" receive_count to 0");
-            D("^@");
+        if (node->new_count > 0) {
+            // increase rate is capped by max transmit rate during threshold
+            if ((count + node->new_count) > max_count) {
+                count = max_count;
+                LOG2(LOG_COUNTCLIPPED, node->node_id, max_count);
+            } else {
+                count += node->new_count;
+            }
+            node->receive_count = count;
+            node->new_count = 0;
+            node->last_heard = currentTime;
+        } else if ((node->receive_count > 0) && (count == 0)) {
+            // Any nodes w/o a receive_count loose last_heard
+            node->receive_count = 0;
+            node->last_heard = 0;
+            LOG1(LOG_COUNTZEROED, node->node_id);
         }
+    }
+}
+
+word activeNodes(unsigned long currentTime) {
+    // bit per nodeInfo index that meets >= GOODMSGMIN in THRESHOLD
+    word result = 0;
 
-        // Any nodes w/o a receive_count loose last_heard
-        if (nodeInfo[nodeCount].receive_count == 0) {
-            nodeInfo[nodeCount].last_heard = 0;
-            PRINTTIME(currentTime);
-            D("Clipped node_id "); D(nodeInfo[nodeCount].node_id);
-            D(" last_heard to 0");
-            D("^@");
+    for (int nodeCount=0; nodeCount < MAXNODES; nodeCount++) {
+        if (decayedCount(&nodeInfo[nodeCount], currentTime) >= GOODMSGMIN) {
+            result |= bit(nodeCount);
         }
     }
+    return result;
 }
 
-nodeInfo_t *activeNode(unsigned long currentTime) {
-    nodeInfo_t *result = NULL;
-    // return most recent active node that meets >= GOODMSGMIN in THRESHOLD
-    // or NULL if none meet the criteria
+byte readNodePriority(int index) {
+    // cold like the servo limits, a single EEPROM byte is cheap to read
+    if (nodeStoreOK == false) {
+        return 0;
+    }
+    return eeprom_read_byte(&nodeStore[index].priority);
+}
+
+int bestNode(word nodes) {
+    // index in nodes with the highest priority, most recent wins a tie
+    int result = -1;
+    byte resultPriority = 0;
 
     for (int nodeCount=0; nodeCount < MAXNODES; nodeCount++) {
-        if (nodeInfo[nodeCount].receive_count >= GOODMSGMIN) {
-            if (result != NULL) { // most recent wins
-                if (nodeInfo[nodeCount].last_heard > result->last_heard) {
-                    PRINTMESSAGE(currentTime, message, signalStrength);
-                    PRINTTIME(currentTime);
-                    D("Warning: Node ");
-                    D(nodeInfo[nodeCount].node_id);
-                    D(" is competing with node ");
-                    D(result->node_id);
-                    D("\n");
-                    result = &nodeInfo[nodeCount];
-                }
-            } else { // first match
-                result = &nodeInfo[nodeCount];
+        byte priority = 0;
+
+        if ((nodes & bit(nodeCount)) == 0) {
+            continue;
+        }
+        priority = readNodePriority(nodeCount);
+        if ((result < 0) || (priority > resultPriority) ||
+            ((priority == resultPriority) &&
+             (nodeInfo[nodeCount].last_heard > nodeInfo[result].last_heard))) {
+            result = nodeCount;
+            resultPriority = priority;
+        }
+    }
+    return result;
+}
+
+word activePorts(unsigned long currentTime) {
+    // Port mask wanted by active nodes, at most MAXOPENPORTS taken in
+    // priority order. Nodes sharing an open port ride along for free.
+    // currentActive is set to the top node, or NULL when none are active.
+    static word waiting = 0; // nodes already warned about
+    word nodes = activeNodes(currentTime);
+    word nowWaiting = 0;
+    word result = 0;
+    byte opened = 0;
+
+    currentActive = NULL;
+    while (nodes != 0) {
+        int node = bestNode(nodes);
+        byte port_id = nodeInfo[node].port_id;
+        word portBit = ALLPORTS; // not mapped, open everything
+
+        nodes &= ~bit(node);
+        if ((port_id > 0) && (port_id <= MAXPORTS)) {
+            portBit = bit(port_id - 1);
+        }
+        if (currentActive == NULL) {
+            currentActive = &nodeInfo[node];
+        }
+        if ((result & portBit) == portBit) {
+            continue; // port already open
+        }
+        if (opened >= MAXOPENPORTS) {
+            if ((waiting & bit(node)) == 0) { // only warn once
+                LOG2(LOG_COMPETING, nodeInfo[node].node_id,
+                     currentActive->node_id);
             }
+            nowWaiting |= bit(node);
+            continue;
         }
+        result |= portBit;
+        opened++;
     }
+    waiting = nowWaiting;
     return result;
 }
 
-nodeInfo_t *findNode(byte node_id) {
-    nodeInfo_t *result = NULL;
+word findNodes(byte node_id, byte channels) {
+    // bit per nodeInfo index for node_id and any of its channels set
+    word result = 0;
 
     // filter out invalid IDs
     if ((node_id != 255) && (node_id != 0)) {
         for (int nodeCount=0; nodeCount < MAXNODES; nodeCount++) {
-            if (nodeInfo[nodeCount].node_id == node_id) {
-                result == &nodeInfo[nodeCount];
+            byte channel = nodeInfo[nodeCount].channel;
+
+            if ((nodeInfo[nodeCount].node_id == node_id) &&
+                ((channel == 0) || (channels & bit(channel - 1)))) {
+                result |= bit(nodeCount);
             }
         }
     }
@@ -91,24 +148,129 @@ void setupNodeInfo(void) {
     for (int nodeCount=0; nodeCount < MAXNODES; nodeCount++) {
         nodeInfo[nodeCount].node_id = 0;
         nodeInfo[nodeCount].port_id = 0;
-        nodeInfo[nodeCount].servo_min = servoCenterPW;
-        nodeInfo[nodeCount].servo_max = servoCenterPW;
+        nodeInfo[nodeCount].channel = 0;
         nodeInfo[nodeCount].receive_count = 0;
         nodeInfo[nodeCount].new_count = 0;
         nodeInfo[nodeCount].last_heard =0;
-        for (int nameChar=0; nameChar < (NODENAMEMAX); nameChar++) {
-            nodeInfo[nodeCount].node_name[nameChar] = '\0';
-        }
     }
 }
 
+word nodeRecordCRC(const nodeRecord_t *record) {
+    const byte *data = (const byte *) record;
+    word crc = 0xFFFF;
+
+    for (byte index=0; index < offsetof(nodeRecord_t, crc); index++) {
+        crc = _crc16_update(crc, data[index]);
+    }
+    return crc;
+}
+
+byte nodeStoreVersion(void) {
+    // layout version stored, 0 if blank or not a node store
+    nodeStoreHeader_t header;
+
+    eeprom_read_block(&header, &nodeStoreHeader, sizeof(header));
+    if ((header.magic != NODESTOREMAGIC) || (header.count != MAXNODES)) {
+        return 0;
+    }
+    return header.version;
+}
+
+boolean nodeStoreValid(void) {
+    return nodeStoreVersion() == NODESTOREVERSION;
+}
+
+boolean readNodeRecord(int index, nodeRecord_t *record) {
+    // false if the stored record is corrupt
+    eeprom_read_block(record, &nodeStore[index], sizeof(nodeRecord_t));
+    return record->crc == nodeRecordCRC(record);
+}
+
+void writeNodeRecord(int index, nodeRecord_t *record) {
+    // eeprom_update_block() only writes bytes that differ
+    record->crc = nodeRecordCRC(record);
+    eeprom_update_block(record, &nodeStore[index], sizeof(nodeRecord_t));
+}
+
+boolean readOldNodeRecord(int index, byte version, nodeRecord_t *record) {
+    // Versions 1-3 were this layout up to node_name, with priority (2) or
+    // channel then priority (3) after port_id. False if corrupt.
+    byte inserted = version - 1; // bytes between port_id and servo_min
+    byte size = offsetof(nodeRecord_t, priority) + inserted + sizeof(word);
+    byte data[sizeof(nodeRecord_t)];
+    word crc = 0xFFFF;
+    word storedCRC = 0;
+
+    eeprom_read_block(data, (const byte *) nodeStore + (index * size), size);
+    for (byte dataIndex=0; dataIndex < (size - sizeof(word)); dataIndex++) {
+        crc = _crc16_update(crc, data[dataIndex]);
+    }
+    memcpy(&storedCRC, &data[size - sizeof(word)], sizeof(word));
+    if (crc != storedCRC) {
+        return false;
+    }
+    record->node_id = data[0];
+    record->port_id = data[1];
+    record->channel = (version >= 3) ? data[2] : 0;
+    record->priority = (version >= 2) ? data[inserted + 1] : 0;
+    memcpy(&record->servo_min, &data[2 + inserted],
+           offsetof(nodeRecord_t, priority) -
+           offsetof(nodeRecord_t, servo_min));
+    return true;
+}
+
+void defaultNodeRecord(nodeRecord_t *record) {
+    record->node_id = 0;
+    record->port_id = 0;
+    record->channel = 0;
+    record->priority = 0;
+    record->servo_min = servoCenterPW;
+    record->servo_max = servoCenterPW;
+    memset(record->node_name, '\0', NODENAMEMAX-1);
+}
+
+void readNodeServo(int index, word *servo_min, word *servo_max) {
+    // Just the calibration, CRC was already checked at boot
+    if (nodeStoreOK == false) {
+        *servo_min = servoCenterPW;
+        *servo_max = servoCenterPW;
+        return;
+    }
+    *servo_min = eeprom_read_word(&nodeStore[index].servo_min);
+    *servo_max = eeprom_read_word(&nodeStore[index].servo_max);
+}
+
+void readNodeName(int index, char *node_name) {
+    // node_name must hold NODENAMEMAX characters
+    if (nodeStoreOK == false) {
+        memset(node_name, '\0', NODENAMEMAX);
+        return;
+    }
+    eeprom_read_block(node_name, nodeStore[index].node_name, NODENAMEMAX-1);
+    node_name[NODENAMEMAX-1] = '\0'; // not stored
+}
+
 void printNodeInfo(int index) {
-        D("Node Name: '"); D(nodeInfo[index].node_name);
+        nodeRecord_t record;
+
+        if ((nodeStoreValid() == false) ||
+            (readNodeRecord(index, &record) == false)) {
+            defaultNodeRecord(&record);
+        }
+        D("Node Name: '");
+        for (int nameChar=0; nameChar < (NODENAMEMAX-1); nameChar++) {
+            if (record.node_name[nameChar] == '\0') {
+                break;
+            }
+            D(record.node_name[nameChar]);
+        }
         D("'");
         D(" Node ID: "); D(nodeInfo[index].node_id);
         D(" Port ID: "); D(nodeInfo[index].port_id);
-        D(" Servo Min: "); D(nodeInfo[index].servo_min);
-        D(" Servo Max: "); D(nodeInfo[index].servo_max);
+        D(" Channel: "); D(nodeInfo[index].channel);
+        D(" Priority: "); D(record.priority);
+        D(" Servo Min: "); D(record.servo_min);
+        D(" Servo Max: "); D(record.servo_max);
         D(" Messags: "); D(nodeInfo[index].receive_count);
         D(" + Mesgs: "); D(nodeInfo[index].new_count);
         D(" last ms: "); D(nodeInfo[index].last_heard);
@@ -123,119 +285,79 @@ void printNodes(void) {
 #endif
 }
 
-void readNodeIDServoMap(void) {
-    int address = 0;
-
-    D("Reading nodeInfo from EEPROM");
-
-    for (int nodeCount=0; nodeCount < MAXNODES; nodeCount++) {
-
-        // node_id
-        nodeInfo[nodeCount].node_id = EEPROM.read(address);
-        address++;
-        if (nodeInfo[nodeCount].node_id == 255) { // uninitialized EEPROM
-            nodeInfo[nodeCount].node_id = 0;
-        }
-        D(".");
-
-        // port_id
-        nodeInfo[nodeCount].port_id = EEPROM.read(address);
-        address++;
-        if (nodeInfo[nodeCount].port_id == 255) { // uninitialized EEPROM
-            nodeInfo[nodeCount].port_id = 0;
-        }
-        D(".");
+void writeNodeIDServoMap(void) {
+    // Sync hot node_id/port_id/channel back into records, cold untouched
+    nodeStoreHeader_t header;
+    nodeRecord_t record;
 
-        // servo_min (word)
-        nodeInfo[nodeCount].servo_min = EEPROM.read(address) << 8;
-        address++;
-        nodeInfo[nodeCount].servo_min |= EEPROM.read(address);
-        address++;
-        if (nodeInfo[nodeCount].servo_min == 65535) { // uninitialized EEPROM
-            nodeInfo[nodeCount].servo_min = servoCenterPW;
-        }
-        D(".");
+    D("Writing nodeInfo to EEPROM");
 
-        // servo_max (word)
-        nodeInfo[nodeCount].servo_max = EEPROM.read(address) << 8;
-        address++;
-        nodeInfo[nodeCount].servo_min |= EEPROM.read(address);
-        address++;
-        if (nodeInfo[nodeCount].servo_max == 65535) { // uninitialized EEPROM
-            nodeInfo[nodeCount].servo_max = servoCenterPW;
-        }
-        D(".");
+    header.magic = NODESTOREMAGIC;
+    header.version = NODESTOREVERSION;
+    header.count = MAXNODES;
+    eeprom_update_block(&header, &nodeStoreHeader, sizeof(header));
 
-        // node_name (NODENAMEMAX-1 bytes)
-        for (int nameChar=0; nameChar < (NODENAMEMAX-1); nameChar++) {
-            nodeInfo[nodeCount].node_name[nameChar] = EEPROM.read(address);
-            address++;
-            if (nodeInfo[nodeCount].node_name[nameChar] == 255) {
-                // uninitialized EEPROM
-                nodeInfo[nodeCount].node_name[nameChar] = '\0';
-            }
+    for (int nodeCount=0; nodeCount < MAXNODES; nodeCount++) {
+        if (readNodeRecord(nodeCount, &record) == false) {
+            defaultNodeRecord(&record); // replace corrupt record
         }
-        nodeInfo[nodeCount].node_name[NODENAMEMAX-1] = '\0'; // not stored
+        record.node_id = nodeInfo[nodeCount].node_id;
+        record.port_id = nodeInfo[nodeCount].port_id;
+        record.channel = nodeInfo[nodeCount].channel;
+        writeNodeRecord(nodeCount, &record);
         D(".");
     }
+    nodeStoreOK = true;
     D("\n");
 }
 
-void writeNodeIDServoMap(void) {
-    int address = 0;
-    byte currentByte = 0;
-    word currentWord = 0;
+void migrateNodeStore(byte version) {
+    // Records only grow, converting from the last one down means none is
+    // overwritten before it's read. Header goes last, an interrupted
+    // migration starts over (records already done then fail their CRC).
+    nodeStoreHeader_t header;
+    nodeRecord_t record;
 
-    D("Writing nodeInfo to EEPROM");
+    for (int nodeCount=MAXNODES-1; nodeCount >= 0; nodeCount--) {
+        if (readOldNodeRecord(nodeCount, version, &record) == false) {
+            D(" Bad CRC node "); D(nodeCount); D(" ");
+            defaultNodeRecord(&record);
+        }
+        writeNodeRecord(nodeCount, &record);
+    }
+    header.magic = NODESTOREMAGIC;
+    header.version = NODESTOREVERSION;
+    header.count = MAXNODES;
+    eeprom_update_block(&header, &nodeStoreHeader, sizeof(header));
+}
 
-    for (int nodeCount=0; nodeCount < MAXNODES; nodeCount++) {
+void readNodeIDServoMap(void) {
+    // Only the hot fields are loaded, the rest stays in EEPROM
+    nodeRecord_t record;
+    byte version = nodeStoreVersion();
 
-        // Only write nodeID if it changed
-        currentByte = EEPROM.read(address);
-        if (currentByte != nodeInfo[nodeCount].node_id) {
-            EEPROM.write(address, nodeInfo[nodeCount].node_id);
-            D(".");
-        }
-        address++;
+    D("Reading nodeInfo from EEPROM");
 
-        // Only write port_id if it changed
-        currentByte = EEPROM.read(address);
-        if (currentByte != nodeInfo[nodeCount].port_id) {
-            EEPROM.write(address, nodeInfo[nodeCount].port_id);
-            D(".");
-        }
-        address++;
-
-        // Only write servo min if it changed
-        currentWord = EEPROM.read(address) << 8;
-        currentWord |= EEPROM.read(address + 1);
-        if (currentWord != nodeInfo[nodeCount].servo_min) {
-            EEPROM.write(address, highByte(nodeInfo[nodeCount].servo_min));
-            EEPROM.write(address + 1, lowByte(nodeInfo[nodeCount].servo_min));
-            D(".");
-        }
-        address += 2;
-
-        // Only write Servo max if it changed
-        currentWord = EEPROM.read(address) << 8;
-        currentWord |= EEPROM.read(address + 1);
-        if (currentWord != nodeInfo[nodeCount].servo_max) {
-            EEPROM.write(address, highByte(nodeInfo[nodeCount].servo_max));
-            EEPROM.write(address, lowByte(nodeInfo[nodeCount].servo_max));
-            D(".");
-        }
-        address += 2;
+    if ((version >= NODESTOREOLDEST) && (version < NODESTOREVERSION)) {
+        D(": migrating version "); D(version);
+        migrateNodeStore(version);
+        version = NODESTOREVERSION;
+    }
+    if (version != NODESTOREVERSION) { // blank, foreign or newer
+        D(": none usable, left alone until written\n");
+        return; // setupNodeInfo() defaults, cold fields read as defaults
+    }
+    nodeStoreOK = true;
 
-        // Only write name bytes that changed
-        for (int nameChar=0; nameChar < (NODENAMEMAX-1); nameChar++) {
-            currentByte = EEPROM.read(address);
-            if (currentByte != nodeInfo[nodeCount].node_name[nameChar]) {
-                EEPROM.write(address, nodeInfo[nodeCount].node_name[nameChar]);
-                address++;
-            }
-            address++;
+    for (int nodeCount=0; nodeCount < MAXNODES; nodeCount++) {
+        if (readNodeRecord(nodeCount, &record) == false) {
+            D(" Bad CRC node "); D(nodeCount); D(" ");
+            continue; // keep setupNodeInfo() defaults, node unused
         }
-        // nodeInfo[nodeCount].node_name[NODENAMEMAX-1] always init to '\0'
+        nodeInfo[nodeCount].node_id = record.node_id;
+        nodeInfo[nodeCount].port_id = record.port_id;
+        nodeInfo[nodeCount].channel = record.channel;
+        D(".");
     }
     D("\n");
 }
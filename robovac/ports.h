@@ -0,0 +1,217 @@
+#ifndef PORTS_H
+#define PORTS_H
+
+// PCA9685 registers used for burst updates
+#define PCA9685_MODE1 0x00
+#define PCA9685_MODE1_AI 0x20 // register auto-increment
+#define PCA9685_LED0_ON_L 0x06 // 4 registers per channel follow
+#define PCA9685_FULL_OFF 0x1000 // LEDn_OFF bit 12, output held low
+
+// Wire's buffer holds the register address + 4 bytes per channel
+#define PORTSPERBURST ((BUFFER_LENGTH - 1) / 4)
+
+void pwmWrite8(byte reg, byte value) {
+    Wire.beginTransmission(PWMI2CADDR);
+    Wire.write(reg);
+    Wire.write(value);
+    Wire.endTransmission();
+}
+
+byte pwmRead8(byte reg) {
+    Wire.beginTransmission(PWMI2CADDR);
+    Wire.write(reg);
+    Wire.endTransmission();
+    Wire.requestFrom((uint8_t) PWMI2CADDR, (uint8_t) 1);
+    return Wire.read();
+}
+
+void setupPorts(void) {
+    // Bursts rely on the chip stepping through LEDn registers by itself
+    pwmWrite8(PCA9685_MODE1, pwmRead8(PCA9685_MODE1) | PCA9685_MODE1_AI);
+
+    for (int port=0; port < MAXPORTS; port++) {
+        portPW[port] = 0;
+        portWritten[port] = ~0; // force first write
+        portFrom[port] = 0; // position unknown until first move
+        portTarget[port] = 0;
+        portDuration[port] = 0;
+        portStart[port] = 0;
+    }
+}
+
+int portNode(byte port) {
+    // index of first configured node mapped to port (1..MAXPORTS) or -1
+    for (int nodeCount=0; nodeCount < MAXNODES; nodeCount++) {
+        if ((nodeInfo[nodeCount].node_id != 0) &&
+            (nodeInfo[nodeCount].port_id == port)) {
+            return nodeCount;
+        }
+    }
+    return -1;
+}
+
+word profileTime(word distance) {
+    // ms for a trapezoidal move of distance PWM counts
+    if (distance >= ((unsigned long) SERVOSPEED * SERVOSPEED / SERVOACCEL)) {
+        // accelerate, cruise at SERVOSPEED, decelerate
+        return ((unsigned long) distance * 1000 / SERVOSPEED) +
+               ((unsigned long) SERVOSPEED * 1000 / SERVOACCEL);
+    } else { // too short to reach SERVOSPEED, triangular profile
+        return 2 * isqrt((unsigned long) distance * 1000000 / SERVOACCEL);
+    }
+}
+
+word profileDistance(unsigned long elapsed, word distance, word duration) {
+    // PWM counts covered elapsed ms into a profileTime(distance) move
+    unsigned long rampTime = (unsigned long) SERVOSPEED * 1000 / SERVOACCEL;
+    unsigned long rampDistance = 0;
+    unsigned long result = 0;
+
+    if (elapsed >= duration) {
+        return distance;
+    }
+    rampTime = min(rampTime, (unsigned long) duration / 2);
+    if (elapsed < rampTime) { // accelerating
+        result = (SERVOACCEL * elapsed * elapsed) / 2000000;
+    } else if (elapsed > (duration - rampTime)) { // decelerating
+        unsigned long remaining = duration - elapsed;
+
+        result = distance - ((SERVOACCEL * remaining * remaining) / 2000000);
+    } else { // cruising
+        rampDistance = (SERVOACCEL * rampTime * rampTime) / 2000000;
+        result = rampDistance + ((SERVOSPEED * (elapsed - rampTime)) / 1000);
+    }
+    return min(result, (unsigned long) distance);
+}
+
+void computePorts(word portMask, unsigned long currentTime) {
+    // ports in portMask open, every other mapped port closed
+    // any port whose target changed starts a new profile from where it is
+    byte moving = 0;
+
+    for (int port=0; port < MAXPORTS; port++) {
+        int node = portNode(port + 1);
+        word servo_min = 0;
+        word servo_max = 0;
+        word target = 0;
+        word distance = 0;
+
+        if (node >= 0) {
+            readNodeServo(node, &servo_min, &servo_max);
+        }
+        if (node < 0) {
+            target = 0; // nothing calibrated, don't drive it
+        } else if (portMask & bit(port)) {
+            target = servo_max;
+        } else {
+            target = servo_min;
+        }
+        if (target == portTarget[port]) {
+            continue; // already heading there
+        }
+
+        portFrom[port] = portPW[port];
+        portTarget[port] = target;
+        if ((portFrom[port] == 0) || (target == 0)) {
+            // unknown start or not driven, jump and assume full travel
+            portFrom[port] = target;
+            distance = max(servo_max, servo_min) - min(servo_max, servo_min);
+        } else {
+            distance = max(portFrom[port], target) -
+                       min(portFrom[port], target);
+        }
+        // stagger starts so servos don't all draw inrush current at once
+        portStart[port] = currentTime + (moving * SERVOSTAGGER);
+        portDuration[port] = profileTime(distance);
+        moving++;
+    }
+
+    if (moving == 0) {
+        return; // nothing retargeted, keep the current arrival time
+    }
+    portsArrive = currentTime;
+    for (int port=0; port < MAXPORTS; port++) {
+        unsigned long arrive = portStart[port] + portDuration[port];
+
+        if ((long) (arrive - portsArrive) > 0) {
+            portsArrive = arrive;
+        }
+    }
+    portsArrive += SERVOSETTLETIME;
+}
+
+void updatePorts(unsigned long currentTime) {
+    // move each port's pulse width along its profile
+    for (int port=0; port < MAXPORTS; port++) {
+        word from = portFrom[port];
+        word to = portTarget[port];
+        word covered = 0;
+
+        if ((long) (currentTime - portStart[port]) < 0) {
+            continue; // staggered, not started yet
+        }
+        covered = profileDistance(currentTime - portStart[port],
+                                  max(from, to) - min(from, to),
+                                  portDuration[port]);
+        if (from == to) {
+            portPW[port] = to;
+        } else if (to > from) {
+            portPW[port] = from + covered;
+        } else {
+            portPW[port] = from - covered;
+        }
+    }
+}
+
+boolean portsArrived(unsigned long currentTime) {
+    // true once the slowest profile (plus settle time) has finished
+    return (long) (currentTime - portsArrive) >= 0;
+}
+
+void burstPorts(byte first, byte count) {
+    // One auto-increment transaction covering channels first..first+count-1
+    Wire.beginTransmission(PWMI2CADDR);
+    Wire.write(PCA9685_LED0_ON_L + (4 * first));
+    for (byte port=first; port < (first + count); port++) {
+        // stagger pulse starts so servos don't all draw current at once
+        word on = (port * PORTSTAGGER) & 0x0FFF;
+        word off = PCA9685_FULL_OFF;
+
+        if (portPW[port] != 0) {
+            off = (on + portPW[port]) & 0x0FFF;
+        }
+        Wire.write(lowByte(on));
+        Wire.write(highByte(on));
+        Wire.write(lowByte(off));
+        Wire.write(highByte(off));
+        portWritten[port] = portPW[port];
+    }
+    Wire.endTransmission();
+}
+
+byte writePorts(void) {
+    // Send changed channels, returns number of I2C transactions used
+    byte first = MAXPORTS;
+    byte last = 0;
+    byte bursts = 0;
+
+    for (byte port=0; port < MAXPORTS; port++) {
+        if (portPW[port] != portWritten[port]) {
+            if (first == MAXPORTS) {
+                first = port;
+            }
+            last = port;
+        }
+    }
+    // unchanged channels in between are cheaper to resend than to skip
+    while (first <= last) {
+        byte count = min(last - first + 1, PORTSPERBURST);
+
+        burstPorts(first, count);
+        first += count;
+        bursts++;
+    }
+    return bursts;
+}
+
+#endif // PORTS_H
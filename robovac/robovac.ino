@@ -26,22 +26,37 @@
     Adafruit_PWMServoDriver: git://github.com/adafruit/Adafruit-PWM-Servo-Driver-Library.git
 */
 
+// Must come before <RoboVac.h> so its logging macros are enabled
+#define DEBUG // undefine to turn off all serial output
+
 #include <Arduino.h>
 #include <Wire.h>
-#include <EEPROM.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
 #include <VirtualWire.h>
 #include <TimedEvent.h>
 #include <Adafruit_RGBLCDShield.h>
 #include <Adafruit_PWMServoDriver.h>
 #include <RoboVac.h>
 #include "globals.h"
-#include "control.h"
 #include "nodeinfo.h"
+#include "lcd.h"
+#include "ports.h"
+#include "control.h"
 #include "statemachine.h"
 #include "events.h"
 
 /* Main Program */
 
+int freeRam(void) {
+    // gap between top of heap and bottom of stack
+    extern int __heap_start, *__brkval;
+    int stackTop;
+
+    return (char *) &stackTop - (__brkval == 0 ? (char *) &__heap_start
+                                               : (char *) __brkval);
+}
+
 void setup() {
     // debugging info
     Serial.begin(SERIALBAUD);
@@ -50,6 +65,7 @@ void setup() {
     pinMode(rxDataPin, INPUT);
     pinMode(signalStrengthPin, INPUT);
     vw_set_rx_pin(rxDataPin);
+    vw_set_rx_done_hook(rxDone);
     vw_set_ptt_pin(statusLEDPin);
     pinMode(statusLEDPin, OUTPUT);
     digitalWrite(statusLEDPin, LOW);
@@ -57,7 +73,6 @@ void setup() {
     vw_rx_start();
 
     // Setup events
-    TimedEvent.addTimer(POLLINTERVAL, pollRxEvent);
     TimedEvent.addTimer(STATEINTERVAL, robovacStateEvent);
     TimedEvent.addTimer(STATUSINTERVAL, statusEvent);
     TimedEvent.addTimer(LCDINTERVAL, lcdEvent);
@@ -73,10 +88,12 @@ void setup() {
 
     // set up the LCD's number of columns and rows
     // and pwm servo board
-    lcd.begin(16, 2);
-    lcd.setBacklight(0x1); // ON
+    lcd.begin(LCDCOLS, LCDROWS);
+    lcdInvalidate();
+    lcdBacklight(true);
     pwm.begin();
-    pwm.setPWMFreq(60);
+    pwm.setPWMFreq(PWMFREQ);
+    setupPorts();
 
     // debugging stuff
     D("rxDataPin: "); D(rxDataPin);
@@ -84,12 +101,18 @@ void setup() {
     D("  SERIALBAUD: "); D(SERIALBAUD);
     D("  RXTXBAUD: "); D(RXTXBAUD);
     D("\nStat. Int.: "); D(STATUSINTERVAL);
-    D("ms  Poll Int.: "); D(POLLINTERVAL);
+    D("ms  State Int.: "); D(STATEINTERVAL);
     D("ms\n");
     printNodes();
-    D("\nloop()\n");
+    D("\nnodeInfo: "); D(sizeof(nodeInfo));
+    D(" bytes  Free RAM: "); D(freeRam());
+    D(" bytes\nloop()\n");
 }
 
 void loop() {
-    TimedEvent.loop(); // blocking
+    if (rxPending) { // set by rxDone() as a frame completes
+        handleRx();
+    }
+    TimedEvent.loop();
+    LOGDRAIN(); // idle time, send queued log records
 }
@@ -0,0 +1,17 @@
+/*
+  Host stand-in, ports.h drives the PCA9685 through Wire directly
+*/
+
+#ifndef _ADAFRUIT_PWMServoDriver_H
+#define _ADAFRUIT_PWMServoDriver_H
+
+#include <Arduino.h>
+
+class Adafruit_PWMServoDriver {
+    public:
+        Adafruit_PWMServoDriver(uint8_t addr = 0x40) { }
+        void begin(void) { }
+        void setPWMFreq(float freq) { }
+};
+
+#endif // _ADAFRUIT_PWMServoDriver_H
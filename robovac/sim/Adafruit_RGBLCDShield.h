@@ -0,0 +1,25 @@
+/*
+  Host stand-in, no buttons are ever pressed
+*/
+
+#ifndef Adafruit_RGBLCDShield_h
+#define Adafruit_RGBLCDShield_h
+
+#include <Arduino.h>
+
+#define BUTTON_UP 0x08
+#define BUTTON_DOWN 0x04
+#define BUTTON_LEFT 0x10
+#define BUTTON_RIGHT 0x02
+#define BUTTON_SELECT 0x01
+
+class Adafruit_RGBLCDShield {
+    public:
+        void begin(uint8_t cols, uint8_t rows) { }
+        void setBacklight(uint8_t status) { }
+        uint8_t readButtons(void) { return 0; }
+        void setCursor(uint8_t col, uint8_t row) { }
+        size_t write(uint8_t value) { return 1; }
+};
+
+#endif // Adafruit_RGBLCDShield_h
@@ -0,0 +1,98 @@
+/*
+  Host stand-in for the parts of the Arduino core robovac uses
+
+  Only enough for robosim.cpp, and currentsensenode/replay, to build and
+  run the sketches against virtual time.  Pins, the ADC and millis() are
+  provided by the program including the sketch.
+*/
+
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+
+#define ARDUINO 105
+
+typedef uint8_t byte;
+typedef uint16_t word;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define DEC 10
+#define HEX 16
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define DEFAULT 1
+
+#define F_CPU 16000000UL
+#define F(x) (x)
+#define lowByte(w) ((uint8_t) ((w) & 0xff))
+#define highByte(w) ((uint8_t) ((w) >> 8))
+#define bit(b) (1UL << (b))
+#define _BV(b) (1 << (b))
+#define bit_is_set(sfr, b) ((sfr) & _BV(b))
+
+// ADC registers, ADSC is cleared by the simulator once ADC is loaded
+#define ADPS0 0
+#define ADPS1 1
+#define ADPS2 2
+#define ADIE 3
+#define ADSC 6
+#define ADEN 7
+extern volatile uint8_t ADMUX;
+extern volatile uint8_t ADCSRA;
+extern volatile uint16_t ADC;
+extern volatile uint8_t DIDR0;
+
+// Timer2, only written by currentsensenode's setupSampler()
+#define CS20 0
+#define CS21 1
+#define CS22 2
+#define WGM21 1
+#define OCIE2A 1
+#define OCF2A 1
+extern volatile uint8_t TCCR2A;
+extern volatile uint8_t TCCR2B;
+extern volatile uint8_t OCR2A;
+extern volatile uint8_t TCNT2;
+extern volatile uint8_t TIMSK2;
+extern volatile uint8_t TIFR2;
+
+// Handlers are ordinary functions the host program calls itself
+#define ISR(vector) extern "C" void vector(void)
+#define noInterrupts()
+#define interrupts()
+
+// Arduino's min()/max() are macros that take mixed types
+template <class A, class B> inline A min(A a, B b) { return (b < a) ? b : a; }
+template <class A, class B> inline A max(A a, B b) { return (a < b) ? b : a; }
+
+inline long map(long x, long inMin, long inMax, long outMin, long outMax) {
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+unsigned long millis(void);
+unsigned long micros(void);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+class SimSerial {
+    public:
+        void begin(long baud) { }
+        size_t write(uint8_t value);
+        template <class T> size_t print(T value) { return 0; }
+        template <class T> size_t print(T value, int base) { return 0; }
+};
+
+extern SimSerial Serial;
+
+#endif // ARDUINO_H
@@ -0,0 +1,64 @@
+/*
+  Host stand-in for ebl-arduino TimedEvent, driven by the simulated millis()
+*/
+
+#ifndef TIMEDEVENT_H
+#define TIMEDEVENT_H
+
+#include <Arduino.h>
+
+#define SIMMAXTIMERS 8
+
+struct TimerInformation {
+    short eventId;
+    unsigned long intervalMillis;
+};
+
+typedef struct {
+    short eventId;
+    unsigned long intervalMillis;
+    unsigned long lastEventMillis;
+    void (*onEvent)(TimerInformation *Sender);
+} SimTimer;
+
+class SimTimedEvent {
+    public:
+        SimTimedEvent() : count(0) { }
+        void addTimer(unsigned long intervalMillis,
+                      void (*onEvent)(TimerInformation *Sender)) {
+            addTimer(count, intervalMillis, onEvent);
+        }
+        void addTimer(short eventId, unsigned long intervalMillis,
+                      void (*onEvent)(TimerInformation *Sender)) {
+            if (count < SIMMAXTIMERS) {
+                timers[count].eventId = eventId;
+                timers[count].intervalMillis = intervalMillis;
+                timers[count].lastEventMillis = millis();
+                timers[count].onEvent = onEvent;
+                count++;
+            }
+        }
+        void loop(void) {
+            // same as the library, fire once the interval has passed
+            unsigned long now = millis();
+
+            for (byte index=0; index < count; index++) {
+                if ((now - timers[index].lastEventMillis) >=
+                    timers[index].intervalMillis) {
+                    TimerInformation sender = { timers[index].eventId,
+                                                timers[index].intervalMillis };
+
+                    timers[index].lastEventMillis = now;
+                    timers[index].onEvent(&sender);
+                }
+            }
+        }
+
+    private:
+        SimTimer timers[SIMMAXTIMERS];
+        byte count;
+};
+
+extern SimTimedEvent TimedEvent;
+
+#endif // TIMEDEVENT_H
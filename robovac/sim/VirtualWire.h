@@ -0,0 +1,23 @@
+/*
+  Host stand-in for VirtualWire, robosim.cpp plays the radio channel
+*/
+
+#ifndef VirtualWire_h
+#define VirtualWire_h
+
+#include <Arduino.h>
+
+#define VW_MAX_MESSAGE_LEN 30
+
+void vw_set_rx_pin(uint8_t pin);
+void vw_set_tx_pin(uint8_t pin);
+void vw_set_ptt_pin(uint8_t pin);
+void vw_set_rx_done_hook(void (*hook)());
+void vw_setup(uint16_t speed);
+void vw_rx_start(void);
+uint8_t vw_have_message(void);
+uint8_t vw_get_message(uint8_t *buf, uint8_t *len);
+uint8_t vw_send(uint8_t *buf, uint8_t len);
+uint8_t vx_tx_active(void);
+
+#endif // VirtualWire_h
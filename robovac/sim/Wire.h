@@ -0,0 +1,27 @@
+/*
+  Host stand-in for Wire, counts transactions for robosim.cpp
+*/
+
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <Arduino.h>
+
+#define BUFFER_LENGTH 32
+
+class SimWire {
+    public:
+        unsigned long transactions; // endTransmission() calls
+
+        SimWire() : transactions(0) { }
+        void begin(void) { }
+        void beginTransmission(uint8_t address) { }
+        size_t write(uint8_t value) { return 1; }
+        uint8_t endTransmission(void) { transactions++; return 0; }
+        uint8_t requestFrom(uint8_t address, uint8_t count) { return count; }
+        int read(void) { return 0; }
+};
+
+extern SimWire Wire;
+
+#endif // WIRE_H
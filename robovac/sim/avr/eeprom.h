@@ -0,0 +1,29 @@
+/*
+  Host stand-in, EEMEM variables are ordinary memory
+*/
+
+#ifndef _AVR_EEPROM_H_
+#define _AVR_EEPROM_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define EEMEM
+
+inline void eeprom_read_block(void *dst, const void *src, size_t n) {
+    memcpy(dst, src, n);
+}
+
+inline void eeprom_update_block(const void *src, void *dst, size_t n) {
+    memcpy(dst, src, n);
+}
+
+inline uint8_t eeprom_read_byte(const uint8_t *src) {
+    return *src;
+}
+
+inline uint16_t eeprom_read_word(const uint16_t *src) {
+    return *src;
+}
+
+#endif // _AVR_EEPROM_H_
@@ -0,0 +1,23 @@
+/*
+  Host stand-in, the power reduction register has no effect
+*/
+
+#ifndef _AVR_POWER_H_
+#define _AVR_POWER_H_
+
+#define power_adc_enable() do { } while (0)
+#define power_adc_disable() do { } while (0)
+#define power_spi_enable() do { } while (0)
+#define power_spi_disable() do { } while (0)
+#define power_twi_enable() do { } while (0)
+#define power_twi_disable() do { } while (0)
+#define power_usart0_enable() do { } while (0)
+#define power_usart0_disable() do { } while (0)
+#define power_timer0_enable() do { } while (0)
+#define power_timer0_disable() do { } while (0)
+#define power_timer1_enable() do { } while (0)
+#define power_timer1_disable() do { } while (0)
+#define power_timer2_enable() do { } while (0)
+#define power_timer2_disable() do { } while (0)
+
+#endif // _AVR_POWER_H_
@@ -0,0 +1,17 @@
+/*
+  Host stand-in, sleeping returns at once, the next "interrupt" is the
+  host program's next call into the sketch
+*/
+
+#ifndef _AVR_SLEEP_H_
+#define _AVR_SLEEP_H_
+
+#define SLEEP_MODE_IDLE 0
+#define SLEEP_MODE_ADC 1
+#define SLEEP_MODE_PWR_DOWN 2
+#define SLEEP_MODE_PWR_SAVE 3
+
+#define set_sleep_mode(mode) do { } while (0)
+#define sleep_mode() do { } while (0)
+
+#endif // _AVR_SLEEP_H_
@@ -0,0 +1,613 @@
+/*
+  Host simulator for robovac and its currentsensenode transmitters
+
+  Runs the unmodified robovac sketch (setup(), loop(), handleRx(),
+  activePorts(), handleActionState()...) against virtual time, one loop()
+  per simulated millisecond.  Nodes follow the currentsensenode schedule:
+  updateCurrentEvent every SENSEINTERVAL, txEvent every TXINTERVAL, sending
+  while a tool is on, one frame for all of a node's sensing channels.
+  They share one RF channel: frames take their
+  VirtualWire airtime at RXTXBAUD, any overlap destroys both, and a
+  further random fraction is lost.
+
+  Build from the top of the sketchbook:
+
+    g++ -O2 -Irobovac/sim -Ilibraries/RoboVac -o robosim \
+        robovac/sim/robosim.cpp libraries/RoboVac/RoboVac.cpp
+
+  Add -DGOODMSGMIN=, -DTHRESHOLD=, -DTXINTERVAL= or -DMAXOPENPORTS= to try
+  other values, sweep.py does that for a whole grid in parallel.
+
+    robosim [-s seed] [-n nodes] [-c channels] [-t hours] [-l loss%]
+            [-f schedule] [-o logfile] [-k]
+
+  Without -f, -n nodes (default 3) each sense -c tools (default 1), every
+  tool on its own port and alternating random off and on periods.  A
+  schedule file has one entry per line, '#' starts a comment:
+
+    node <node_id>[.<channel>] <port_id> [priority]
+    <seconds> <node_id>[.<channel>] on|off
+
+  A tool without a channel is a single channel node.
+
+  -o writes the sketch's log records for robolog.py, -k prints the results
+  as a single key=value line for scripts.
+*/
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#include "../robovac.ino"
+
+#define SENSEINTERVAL 34 // currentsensenode updateCurrentEvent interval
+#define SIMMESSAGESIZE 9 // sizeof(message_t) on AVR, host padding differs
+#define FRAMEBITS (48 + 12 * (1 + SIMMESSAGESIZE + 2)) // preamble+len+msg+crc
+#define FRAMETIME ((FRAMEBITS * 1000UL) / RXTXBAUD) // ms on air
+#define SIMSTART 1000 // millis() at setup(), last_heard == 0 means never
+#define SIMSERVOMIN 200 // servo limits written to every node record
+#define SIMSERVOMAX 500
+#define SIMMEANOFF 300.0 // seconds, random schedule tool off periods
+#define SIMMEANON 90.0 // seconds, random schedule tool on periods
+
+/* Simulated hardware */
+
+volatile uint8_t ADMUX = 0;
+volatile uint8_t ADCSRA = 0;
+volatile uint16_t ADC = 0;
+int __heap_start = 0; // freeRam() only prints these
+int *__brkval = NULL;
+SimSerial Serial;
+SimWire Wire;
+SimTimedEvent TimedEvent;
+
+static unsigned long simMillis = 0;
+static byte simPins[32];
+static FILE *simLog = NULL;
+
+unsigned long millis(void) {
+    return simMillis;
+}
+
+unsigned long micros(void) {
+    return simMillis * 1000;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    simPins[pin & 31] = value;
+}
+
+int digitalRead(uint8_t pin) {
+    return simPins[pin & 31];
+}
+
+size_t SimSerial::write(uint8_t value) {
+    if (simLog != NULL) {
+        fputc(value, simLog);
+    }
+    return 1;
+}
+
+/* Simulated radio */
+
+typedef struct {
+    int node; // index into simNodes
+    unsigned long end; // millis() last bit arrives
+    boolean collided; // overlapped another frame
+    message_t message;
+} simFrame_t;
+
+static std::vector<simFrame_t> simFrames; // on air right now
+static void (*simRxDoneHook)() = NULL;
+static boolean simHaveMessage = false;
+static message_t simMessage;
+static double simLoss = 0.0; // fraction of clean frames lost anyway
+static unsigned long framesSent = 0;
+static unsigned long framesCollided = 0;
+static unsigned long framesLost = 0;
+static unsigned long framesOverrun = 0;
+static unsigned long framesDelivered = 0;
+
+void vw_set_rx_pin(uint8_t pin) { }
+void vw_set_tx_pin(uint8_t pin) { }
+void vw_set_ptt_pin(uint8_t pin) { }
+void vw_setup(uint16_t speed) { }
+void vw_rx_start(void) { }
+
+void vw_set_rx_done_hook(void (*hook)()) {
+    simRxDoneHook = hook;
+}
+
+uint8_t vw_have_message(void) {
+    return simHaveMessage;
+}
+
+uint8_t vw_get_message(uint8_t *buf, uint8_t *len) {
+    // Only clean frames are delivered, so the CRC is always good
+    uint8_t count = min(*len, (uint8_t) sizeof(message_t));
+
+    memcpy(buf, &simMessage, count);
+    *len = count;
+    simHaveMessage = false;
+    return true;
+}
+
+/* Simulated nodes */
+
+// One per tool.  Tools on the same node_id are channels of one node and
+// share its radio, RSSI and timers, see addNode().
+typedef struct {
+    byte node_id;
+    byte channel; // 1..MAXCHANNELS, 0 on a single channel node
+    byte port_id;
+    byte priority;
+    int rssi; // ADC reading while its frame is received
+    unsigned long senseTime; // next updateCurrentEvent
+    unsigned long txTime; // next txEvent
+    unsigned long txBusy; // vw_send() waits for the previous frame
+    boolean toolOn; // what the tool is really doing
+    boolean sensed; // sampleTone >= threshold at the last sense
+    unsigned long onSince; // millis() tool came on, 0 once served
+    boolean joining; // vac was already running when the tool came on
+} simNode_t;
+
+typedef struct {
+    unsigned long time;
+    int node_id;
+    int channel;
+    boolean on;
+} simEvent_t;
+
+static std::vector<simNode_t> simNodes;
+static std::vector<simEvent_t> simEvents;
+
+static bool eventBefore(const simEvent_t &a, const simEvent_t &b) {
+    return a.time < b.time;
+}
+
+static int simNodeIndex(int node_id, int channel) {
+    // channel -1 finds node_id's first tool
+    for (size_t index=0; index < simNodes.size(); index++) {
+        if ((simNodes[index].node_id == node_id) &&
+            ((channel < 0) || (simNodes[index].channel == channel))) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+static boolean parseTool(const char *text, int *node_id, int *channel) {
+    // "<node_id>[.<channel>]"
+    *channel = 0;
+    return sscanf(text, "%d.%d", node_id, channel) >= 1;
+}
+
+static void addNode(int node_id, int channel, int port_id, int priority) {
+    int first = simNodeIndex(node_id, -1);
+    simNode_t node;
+
+    memset(&node, 0, sizeof(node));
+    node.node_id = node_id;
+    node.channel = channel;
+    node.port_id = port_id;
+    node.priority = priority;
+    if (first >= 0) { // another channel of the same node
+        node.rssi = simNodes[first].rssi;
+        node.senseTime = simNodes[first].senseTime;
+        node.txTime = simNodes[first].txTime;
+    } else {
+        node.rssi = 300 + (rand() % 500);
+        // nodes power up at unrelated times, so timers are out of phase
+        node.senseTime = SIMSTART + (rand() % SENSEINTERVAL);
+        node.txTime = SIMSTART + (rand() % TXINTERVAL);
+    }
+    simNodes.push_back(node);
+}
+
+static double randomExp(double mean) {
+    return -mean * log((rand() + 1.0) / (RAND_MAX + 2.0));
+}
+
+static void randomSchedule(int nodes, int channels, unsigned long endTime) {
+    for (int tool=0; tool < (nodes * channels); tool++) {
+        int node_id = (tool / channels) + 1;
+        int channel = (channels > 1) ? (tool % channels) + 1 : 0;
+        unsigned long time = SIMSTART;
+
+        addNode(node_id, channel, tool + 1, 0);
+        while (true) {
+            simEvent_t event;
+
+            time += randomExp(SIMMEANOFF) * 1000;
+            if (time >= endTime) {
+                break;
+            }
+            event.time = time;
+            event.node_id = node_id;
+            event.channel = channel;
+            event.on = true;
+            simEvents.push_back(event);
+            time += randomExp(SIMMEANON) * 1000;
+            event.time = min(time, endTime);
+            event.on = false;
+            simEvents.push_back(event);
+        }
+    }
+}
+
+static boolean readSchedule(const char *fileName) {
+    FILE *file = fopen(fileName, "r");
+    char line[128];
+
+    if (file == NULL) {
+        perror(fileName);
+        return false;
+    }
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char tool[16];
+        char state[8];
+        double seconds = 0;
+        int node_id = 0;
+        int channel = 0;
+        int port_id = 0;
+        int priority = 0;
+        simEvent_t event;
+
+        line[strcspn(line, "#")] = '\0';
+        if ((sscanf(line, " node %15s %d %d", tool, &port_id,
+                    &priority) >= 2) && parseTool(tool, &node_id, &channel)) {
+            if ((port_id < 1) || (port_id > MAXPORTS)) {
+                fprintf(stderr, "%s: port_id %d of node %s not 1..%d\n",
+                        fileName, port_id, tool, MAXPORTS);
+                fclose(file);
+                return false;
+            }
+            addNode(node_id, channel, port_id, priority);
+        } else if ((sscanf(line, " %lf %15s %7s", &seconds, tool,
+                           state) == 3) &&
+                   parseTool(tool, &node_id, &channel)) {
+            event.time = SIMSTART + (unsigned long) (seconds * 1000);
+            event.node_id = node_id;
+            event.channel = channel;
+            event.on = (strcmp(state, "on") == 0);
+            simEvents.push_back(event);
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+static void writeNodeStore(void) {
+    // What the LCD menus would have stored, before setup() reads it
+    nodeRecord_t record;
+
+    nodeStoreHeader.magic = NODESTOREMAGIC;
+    nodeStoreHeader.version = NODESTOREVERSION;
+    nodeStoreHeader.count = MAXNODES;
+    for (int index=0; index < MAXNODES; index++) {
+        defaultNodeRecord(&record);
+        if (index < (int) simNodes.size()) {
+            record.node_id = simNodes[index].node_id;
+            record.port_id = simNodes[index].port_id;
+            record.channel = simNodes[index].channel;
+            record.priority = simNodes[index].priority;
+            record.servo_min = SIMSERVOMIN;
+            record.servo_max = SIMSERVOMAX;
+            snprintf(record.node_name, NODENAMEMAX-1, "Sim node %d.%d",
+                     record.node_id, record.channel);
+        }
+        writeNodeRecord(index, &record);
+    }
+}
+
+static void transmit(int index, byte channels) {
+    // txEvent(): vw_send() of a fresh message, after any frame still going
+    simNode_t *node = &simNodes[index];
+    unsigned long start = max(simMillis, node->txBusy);
+    simFrame_t frame;
+
+    frame.node = index;
+    frame.end = start + FRAMETIME;
+    frame.collided = false;
+    frame.message.magic = MESSAGEMAGIC;
+    frame.message.version = MESSAGEVERSION;
+    frame.message.node_id = node->node_id;
+    frame.message.up_time = simMillis;
+    frame.message.channels = channels;
+    for (size_t other=0; other < simFrames.size(); other++) {
+        if (simFrames[other].end > start) { // both garbled at the receiver
+            simFrames[other].collided = true;
+            frame.collided = true;
+        }
+    }
+    node->txBusy = frame.end;
+    simFrames.push_back(frame);
+    framesSent++;
+}
+
+static void simUpdateNodes(void) {
+    for (size_t index=0; index < simNodes.size(); index++) {
+        simNode_t *node = &simNodes[index];
+
+        if (simMillis >= node->senseTime) {
+            node->sensed = node->toolOn;
+            node->senseTime += SENSEINTERVAL;
+        }
+    }
+    // a node's first tool sends for all its channels, timers are shared
+    for (size_t index=0; index < simNodes.size(); index++) {
+        simNode_t *node = &simNodes[index];
+        byte channels = 0;
+
+        if ((simMillis < node->txTime) ||
+            (simNodeIndex(node->node_id, -1) != (int) index)) {
+            continue;
+        }
+        for (size_t other=index; other < simNodes.size(); other++) {
+            simNode_t *tool = &simNodes[other];
+
+            if (tool->node_id != node->node_id) {
+                continue;
+            }
+            if (tool->sensed) {
+                channels |= (tool->channel > 0) ? bit(tool->channel - 1)
+                                                : 0x01;
+            }
+            tool->txTime += TXINTERVAL;
+        }
+        if (channels != 0) {
+            transmit(index, channels);
+        }
+    }
+}
+
+static void simUpdateChannel(void) {
+    // deliver frames whose last bit just arrived
+    for (size_t index=0; index < simFrames.size(); ) {
+        simFrame_t *frame = &simFrames[index];
+
+        if (frame->end > simMillis) {
+            index++;
+            continue;
+        }
+        if (frame->collided) {
+            framesCollided++;
+        } else if ((rand() / (RAND_MAX + 1.0)) < simLoss) {
+            framesLost++;
+        } else if (simHaveMessage) { // sketch hasn't read the last one
+            framesOverrun++;
+        } else {
+            simMessage = frame->message;
+            simHaveMessage = true;
+            framesDelivered++;
+            if (simRxDoneHook != NULL) {
+                simRxDoneHook(); // starts the RSSI conversion
+            }
+            ADC = simNodes[frame->node].rssi;
+            ADCSRA &= ~_BV(ADSC);
+        }
+        simFrames.erase(simFrames.begin() + index);
+    }
+}
+
+/* Metrics */
+
+static std::vector<unsigned long> coldLatency; // tool on to vacuuming
+static std::vector<unsigned long> joinLatency; // same, vac already running
+static unsigned long toolStarts = 0;
+static unsigned long neverServed = 0; // tool went off first
+static unsigned long vacStarts = 0;
+static unsigned long falseStarts = 0; // vac came on with every tool off
+static unsigned long dropouts = 0; // vac went off with a tool still on
+static unsigned long servoPowerCycles = 0;
+static unsigned long servoActuations = 0; // port targets changed
+
+static boolean anyToolOn(void) {
+    for (size_t index=0; index < simNodes.size(); index++) {
+        if (simNodes[index].toolOn) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void applyEvent(const simEvent_t &event) {
+    int index = simNodeIndex(event.node_id, event.channel);
+    simNode_t *node = NULL;
+
+    if (index < 0) {
+        return;
+    }
+    node = &simNodes[index];
+    if (event.on && !node->toolOn) {
+        node->onSince = simMillis;
+        node->joining = (actionState == VAC_VACUUMING);
+        toolStarts++;
+    } else if (!event.on && node->toolOn && (node->onSince != 0)) {
+        neverServed++;
+    }
+    node->toolOn = event.on;
+}
+
+static void simUpdateMetrics(void) {
+    static boolean vacWas = false;
+    static boolean servoWas = false;
+    static word targetWas[MAXPORTS];
+    boolean vacOn = simPins[vacPowerControlPin];
+    boolean servoOn = simPins[servoPowerControlPin];
+
+    if (vacOn && !vacWas) {
+        vacStarts++;
+        if (!anyToolOn()) {
+            falseStarts++;
+        }
+    } else if (!vacOn && vacWas && anyToolOn()) {
+        dropouts++;
+    }
+    if (servoOn && !servoWas) {
+        servoPowerCycles++;
+    }
+    vacWas = vacOn;
+    servoWas = servoOn;
+
+    for (int port=0; port < MAXPORTS; port++) {
+        if (portTarget[port] != targetWas[port]) {
+            servoActuations++;
+            targetWas[port] = portTarget[port];
+        }
+    }
+
+    for (size_t index=0; index < simNodes.size(); index++) {
+        simNode_t *node = &simNodes[index];
+        word portBit = bit(node->port_id - 1);
+
+        if ((node->onSince == 0) || !node->toolOn) {
+            continue;
+        }
+        // served once vacuuming with its port open and servos at rest
+        if ((actionState == VAC_VACUUMING) && vacOn && !portsMoving &&
+            ((openPorts & portBit) == portBit)) {
+            if (node->joining) {
+                joinLatency.push_back(simMillis - node->onSince);
+            } else {
+                coldLatency.push_back(simMillis - node->onSince);
+            }
+            node->onSince = 0;
+        }
+    }
+}
+
+static unsigned long percentile(std::vector<unsigned long> &values,
+                                int percent) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[((values.size() - 1) * percent) / 100];
+}
+
+static void printLatency(const char *name, std::vector<unsigned long> &values,
+                         boolean keyValue) {
+    if (keyValue) {
+        printf(" %s_n=%lu %s_min=%lu %s_p50=%lu %s_p90=%lu %s_p99=%lu"
+               " %s_max=%lu", name, (unsigned long) values.size(),
+               name, percentile(values, 0), name, percentile(values, 50),
+               name, percentile(values, 90), name, percentile(values, 99),
+               name, percentile(values, 100));
+    } else {
+        printf("%-5s time to vacuum ms: n=%lu min %lu p50 %lu p90 %lu"
+               " p99 %lu max %lu\n", name, (unsigned long) values.size(),
+               percentile(values, 0), percentile(values, 50),
+               percentile(values, 90), percentile(values, 99),
+               percentile(values, 100));
+    }
+}
+
+static void printResults(double hours, boolean keyValue) {
+    if (keyValue) {
+        printf("hours=%g tools=%lu GOODMSGMIN=%d THRESHOLD=%d TXINTERVAL=%d"
+               " MAXOPENPORTS=%d sent=%lu collided=%lu lost=%lu overrun=%lu"
+               " delivered=%lu tool_starts=%lu never_served=%lu"
+               " vac_starts=%lu false_starts=%lu dropouts=%lu"
+               " servo_power=%lu servo_moves=%lu i2c=%lu",
+               hours, (unsigned long) simNodes.size(), GOODMSGMIN, THRESHOLD,
+               TXINTERVAL, MAXOPENPORTS, framesSent, framesCollided,
+               framesLost, framesOverrun, framesDelivered, toolStarts,
+               neverServed, vacStarts, falseStarts, dropouts,
+               servoPowerCycles, servoActuations, Wire.transactions);
+        printLatency("cold", coldLatency, true);
+        printLatency("join", joinLatency, true);
+        printf("\n");
+        return;
+    }
+    printf("Simulated %g h, %lu tool(s), GOODMSGMIN %d THRESHOLD %d"
+           " TXINTERVAL %d MAXOPENPORTS %d\n", hours,
+           (unsigned long) simNodes.size(), GOODMSGMIN, THRESHOLD,
+           TXINTERVAL, MAXOPENPORTS);
+    printf("Frames: %lu sent (%lums on air), %lu collided, %lu lost,"
+           " %lu overrun, %lu delivered\n", framesSent, FRAMETIME,
+           framesCollided, framesLost, framesOverrun, framesDelivered);
+    printf("Tool starts: %lu, %lu never served\n", toolStarts, neverServed);
+    printLatency("Cold", coldLatency, false);
+    printLatency("Join", joinLatency, false);
+    printf("Vac starts: %lu, %lu false start(s), %lu dropout(s)\n",
+           vacStarts, falseStarts, dropouts);
+    printf("Servo power cycles: %lu, port moves: %lu,"
+           " I2C transactions: %lu\n", servoPowerCycles, servoActuations,
+           Wire.transactions);
+}
+
+int main(int argc, char *argv[]) {
+    unsigned int seed = 1;
+    int nodes = 3;
+    int channels = 1;
+    double hours = 8;
+    const char *scheduleFile = NULL;
+    boolean keyValue = false;
+    unsigned long endTime = 0;
+    size_t nextEvent = 0;
+    int option = 0;
+
+    while ((option = getopt(argc, argv, "s:n:c:t:l:f:o:k")) != -1) {
+        switch (option) {
+            case 's': seed = atoi(optarg); break;
+            case 'n': nodes = atoi(optarg); break;
+            case 'c': channels = min(max(atoi(optarg), 1), MAXCHANNELS); break;
+            case 't': hours = atof(optarg); break;
+            case 'l': simLoss = atof(optarg) / 100.0; break;
+            case 'f': scheduleFile = optarg; break;
+            case 'o':
+                simLog = fopen(optarg, "wb");
+                if (simLog == NULL) {
+                    perror(optarg);
+                    return 1;
+                }
+                break;
+            case 'k': keyValue = true; break;
+            default:
+                fprintf(stderr, "usage: %s [-s seed] [-n nodes]"
+                        " [-c channels] [-t hours] [-l loss%%]"
+                        " [-f schedule] [-o logfile] [-k]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    srand(seed);
+    endTime = SIMSTART + (unsigned long) (hours * 3600000);
+    if (scheduleFile != NULL) {
+        if (!readSchedule(scheduleFile)) {
+            return 1;
+        }
+    } else {
+        // every tool needs a nodeInfo entry and a port of its own
+        nodes = min(nodes, min(MAXNODES, MAXPORTS) / channels);
+        randomSchedule(nodes, channels, endTime);
+    }
+    std::stable_sort(simEvents.begin(), simEvents.end(), eventBefore);
+    writeNodeStore();
+
+    simMillis = SIMSTART;
+    setup();
+    while (simMillis < endTime) {
+        simMillis++;
+        while ((nextEvent < simEvents.size()) &&
+               (simEvents[nextEvent].time <= simMillis)) {
+            applyEvent(simEvents[nextEvent++]);
+        }
+        simUpdateNodes();
+        simUpdateChannel();
+        loop();
+        simUpdateMetrics();
+    }
+
+    printResults(hours, keyValue);
+    if (simLog != NULL) {
+        fclose(simLog);
+    }
+    return 0;
+}
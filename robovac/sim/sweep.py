@@ -0,0 +1,98 @@
+#!/usr/bin/env python
+
+"""
+Run robosim over a grid of compile time settings, in parallel
+
+    sweep.py [-j jobs] [-s seeds] [robosim options] NAME=v1,v2 ...
+
+Each NAME is a #ifndef guarded define (GOODMSGMIN, THRESHOLD, TXINTERVAL,
+MAXOPENPORTS).  Every combination is built once, then run for seeds
+1..-s (default 4) with robosim's -n, -c, -t, -l and -f passed on, e.g.
+
+    sweep.py -s 8 -t 4 -l 5 GOODMSGMIN=2,3,4 TXINTERVAL=500,1002
+
+Results are averaged over the seeds and printed one row per combination.
+"""
+
+import itertools
+import multiprocessing
+import multiprocessing.pool
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+# robosim options passed through, all take a value.  -o and -k are not:
+# every run would write the same log, and sweep.py adds -k itself.
+OPTIONS = ["-n", "-c", "-t", "-l", "-f"]
+HERE = os.path.dirname(os.path.abspath(__file__))
+TOP = os.path.normpath(os.path.join(HERE, "..", ".."))
+COLUMNS = ["cold_p50", "cold_p90", "join_p50", "join_p90", "never_served",
+           "false_starts", "dropouts", "servo_power", "servo_moves",
+           "collided"]
+
+
+def build(workdir, defines):
+    binary = os.path.join(workdir, "robosim_" + "_".join(
+        "%s%s" % item for item in defines))
+    command = ["g++", "-O2", "-I" + HERE,
+               "-I" + os.path.join(TOP, "libraries", "RoboVac"),
+               "-o", binary, os.path.join(HERE, "robosim.cpp"),
+               os.path.join(TOP, "libraries", "RoboVac", "RoboVac.cpp")]
+    command += ["-D%s=%s" % item for item in defines]
+    subprocess.check_call(command)
+    return binary
+
+
+def run(binary, seed, options):
+    output = subprocess.check_output([binary, "-k", "-s", str(seed)] +
+                                     options)
+    return dict(pair.split("=") for pair in output.decode().split())
+
+
+def parse_args(argv):
+    jobs, seeds, options, grid = multiprocessing.cpu_count(), 4, [], []
+    args = iter(argv)
+    for arg in args:
+        if arg == "-j":
+            jobs = int(next(args))
+        elif arg == "-s":
+            seeds = int(next(args))
+        elif "=" in arg:
+            name, values = arg.split("=", 1)
+            grid.append([(name, value) for value in values.split(",")])
+        elif arg in OPTIONS:
+            options += [arg, next(args)]
+        else:
+            sys.exit(__doc__)
+    return jobs, seeds, options, grid
+
+
+def main(argv):
+    jobs, seeds, options, grid = parse_args(argv)
+    combos = list(itertools.product(*grid))
+    pool = multiprocessing.pool.ThreadPool(jobs) # work is in subprocesses
+    workdir = tempfile.mkdtemp(prefix="robosim")
+    try:
+        binaries = pool.map(lambda combo: build(workdir, combo), combos)
+        runs = [(combo, binary, seed)
+                for combo, binary in zip(combos, binaries)
+                for seed in range(1, seeds + 1)]
+        results = pool.map(lambda job: run(job[1], job[2], options), runs)
+    finally:
+        shutil.rmtree(workdir)
+
+    names = [item[0] for item in combos[0]] if combos and combos[0] else []
+    print(" ".join(["%12s" % name for name in names + COLUMNS]))
+    for index, combo in enumerate(combos):
+        mine = results[index * seeds:(index + 1) * seeds]
+        row = ["%12s" % value for name, value in combo]
+        for column in COLUMNS:
+            mean = sum(float(result[column]) for result in mine) / len(mine)
+            row.append("%12.1f" % mean)
+        print(" ".join(row))
+
+
+if __name__ == "__main__":
+    main(sys.argv[1:])
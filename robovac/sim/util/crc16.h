@@ -0,0 +1,22 @@
+/*
+  Host copy of the avr-libc reference implementation
+*/
+
+#ifndef _UTIL_CRC16_H_
+#define _UTIL_CRC16_H_
+
+#include <stdint.h>
+
+inline uint16_t _crc16_update(uint16_t crc, uint8_t a) {
+    crc ^= a;
+    for (int i = 0; i < 8; ++i) {
+        if (crc & 1) {
+            crc = (crc >> 1) ^ 0xA001;
+        } else {
+            crc = (crc >> 1);
+        }
+    }
+    return crc;
+}
+
+#endif // _UTIL_CRC16_H_
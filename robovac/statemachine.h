@@ -2,39 +2,32 @@
 #define STATEMACHINE_H
 
 void updateState(vacstate_t newState, unsigned long currentTime) {
-    const char *stateStr;
-
     if (newState > VAC_ENDSTATE) {
         actionState = VAC_ENDSTATE;
     }
 
-    PRINTMESSAGE(currentTime, message, signalStrength);
-    PRINTTIME(currentTime);
-    STATE2STRING(actionState);
-    D("State Change: "); D(stateStr);
-    STATE2STRING(newState);
-    D(" -> "); D(stateStr);
-    D("\n");
+    PRINTMESSAGE(message, signalStrength);
+    LOG2(LOG_STATECHANGE, actionState, newState);
     actionState = newState;
     lastStateChange = currentTime;
 }
 
 void handleActionState(unsigned long currentTime) {
+    word wantedPorts = 0;
 
     // Handle overall state
     switch (actionState) {
 
         case VAC_LISTENING:
-            // The only place lastActive is updated
-            lastActive = currentActive = activeNode(currentTime);
-            if (currentActive != NULL) {
+            wantedPorts = activePorts(currentTime);
+            if (wantedPorts != 0) {
                 updateState(VAC_VACPOWERUP, currentTime);
             }
             break;
 
         case VAC_VACPOWERUP:
-            currentActive = activeNode(currentTime);
-            if (currentActive != NULL) { // node remained active
+            wantedPorts = activePorts(currentTime);
+            if (wantedPorts != 0) { // node(s) remained active
                 vacControl(true); // Power ON
                 if (currentTime > (lastStateChange + VACPOWERTIME)) {
                     // powerup finished
@@ -46,8 +39,8 @@ void handleActionState(unsigned long currentTime) {
             break;
 
         case VAC_SERVOPOWERUP:
-            currentActive = activeNode(currentTime);
-            if (currentActive != NULL) { // node remained active
+            wantedPorts = activePorts(currentTime);
+            if (wantedPorts != 0) { // node(s) remained active
                 servoControl(true); // Power on
                 if (currentTime > (lastStateChange + SERVOPOWERTIME)) {
                     // Servo powerup finished
@@ -59,23 +52,24 @@ void handleActionState(unsigned long currentTime) {
             break;
 
         case VAC_SERVOACTION:
-            currentActive = activeNode(currentTime);
-            if (currentActive != NULL) { // node remained active
-                moveServos(currentActive->port_id);
-                if ( (lastActive == currentActive) && // node didn't change
-                     (currentTime > (lastStateChange + SERVOMOVETIME))) {
+            wantedPorts = activePorts(currentTime);
+            if (wantedPorts != 0) { // node(s) remained active
+                // a node change re-targets the profiles and extends the wait
+                openPorts = wantedPorts;
+                moveServos(openPorts, currentTime);
+                if (portsArrived(currentTime)) { // slowest port is there
                     updateState(VAC_SERVOPOWERDN, currentTime);
-                } // not enough time and/or node id changed
+                } // ports still moving
             } else { // node shutdown
                 updateState(VAC_SERVOSTANDBY, currentTime);
             }
             break;
         case VAC_SERVOPOWERDN:
-            currentActive = activeNode(currentTime);
-            if (currentActive != NULL) { // node remained active
+            wantedPorts = activePorts(currentTime);
+            if (wantedPorts != 0) { // node(s) remained active
                 servoControl(false); // Power off
-                if ( (lastActive == currentActive) && // node didn't change
-                     (currentTime > (lastStateChange + SERVOPOWERTIME))) {
+                if (currentTime > (lastStateChange + SERVOPOWERTIME)) {
+                    // VAC_VACUUMING picks up any change in nodes
                     updateState(VAC_VACUUMING, currentTime);
                 } // not enough time
             } else { // node shutdown
@@ -84,10 +78,23 @@ void handleActionState(unsigned long currentTime) {
             break;
 
         case VAC_VACUUMING:
-            currentActive = activeNode(currentTime);
-            if (currentActive != NULL) { // some node remained active
-                if (lastActive != currentActive) { // node changed!
-                    updateState(VAC_SERVOPOWERUP, currentTime);
+            wantedPorts = activePorts(currentTime);
+            if (wantedPorts != 0) { // some node remained active
+                if (wantedPorts != openPorts) { // nodes joined or left
+                    // Only changed ports move, from wherever they are now.
+                    // Servos just powered need SERVOPOWERTIME first.
+                    servoControl(true); // Power on
+                    computePorts(wantedPorts, portsMoving ? currentTime :
+                                 currentTime + SERVOPOWERTIME);
+                    openPorts = wantedPorts;
+                    portsMoving = true;
+                }
+                if (portsMoving) {
+                    moveServos(openPorts, currentTime);
+                    if (portsArrived(currentTime)) {
+                        servoControl(false); // Power off
+                        portsMoving = false;
+                    }
                 } // else keep vaccuuming
             } else { // node shutdown
                 updateState(VAC_VACPOWERDN, currentTime);
@@ -97,7 +104,8 @@ void handleActionState(unsigned long currentTime) {
         case VAC_VACPOWERDN:
             // ignore any nodes comming online, must go through VAC_SERVOSTANDBY
             // before VAC_VACPOWERUP
-            lastActive = currentActive = NULL;
+            currentActive = NULL;
+            portsMoving = false; // VAC_SERVOSTANDBY moves them all anyway
             vacControl(false); // Power OFF
             if (currentTime > (lastStateChange + VACPOWERTIME)) {
                 // waited long enough
@@ -107,7 +115,7 @@ void handleActionState(unsigned long currentTime) {
 
         case VAC_SERVOPOSTPOWERUP:
             // ignore any nodes comming online, must go through VAC_SERVOSTANDBY
-            lastActive = currentActive = NULL;
+            currentActive = NULL;
             servoControl(true); // Power on
             if (currentTime > (lastStateChange + SERVOPOWERTIME)) {
                 // Servo powerup finished
@@ -117,16 +125,16 @@ void handleActionState(unsigned long currentTime) {
 
         case VAC_SERVOSTANDBY:
             // ignore any nodes comming online, must go through VAC_SERVOSTANDBY
-            lastActive = currentActive = NULL;
-            moveServos(0); // open all ports
-            if (currentTime > (lastStateChange + SERVOMOVETIME)) {
+            currentActive = NULL;
+            moveServos(ALLPORTS, currentTime); // open all ports
+            if (portsArrived(currentTime)) {
                 updateState(VAC_SERVOPOSTPOWERDN, currentTime);
             } // else wait longer
             break;
 
         case VAC_SERVOPOSTPOWERDN:
             // ignore any nodes comming online
-            lastActive = currentActive = NULL;
+            currentActive = NULL;
             servoControl(false); // Power off
             if (currentTime > (lastStateChange + SERVOPOWERTIME)) {
                 updateState(VAC_ENDSTATE, currentTime);
@@ -136,7 +144,7 @@ void handleActionState(unsigned long currentTime) {
         case VAC_ENDSTATE:
         default:
             // ignore any nodes comming online
-            lastActive = currentActive = NULL;
+            currentActive = NULL;
             // Make sure everything powered off
             servoControl(false); // Power off
             vacControl(false); // Power OFF
@@ -145,8 +153,113 @@ void handleActionState(unsigned long currentTime) {
     }
 }
 
-void handleLCDState(unsigned int currentTime) {
+void updateLCDState(lcdState_t newState, unsigned long currentTime) {
+    if (newState > LCD_ENDSTATE) {
+        newState = LCD_ENDSTATE;
+    }
+    lcdState = newState;
+    lastLCDStateChange = currentTime;
+}
+
+void handleLCDMenu(uint8_t pressed, unsigned long currentTime) {
+    if (lcdNodeIndex < MAXNODES) { // browsing Port/ID Names
+        if ((pressed & BUTTON_UP) && (lcdNodeIndex > 0)) {
+            lcdNodeIndex--;
+        } else if ((pressed & BUTTON_DOWN) && (lcdNodeIndex < MAXNODES-1)) {
+            lcdNodeIndex++;
+        } else if (pressed & (BUTTON_LEFT | BUTTON_SELECT)) {
+            lcdNodeIndex = MAXNODES; // back to menu
+        }
+    } else {
+        if ((pressed & BUTTON_UP) && (lcdMenuItem > 0)) {
+            lcdMenuItem--;
+        } else if ((pressed & BUTTON_DOWN) && (lcdMenuItem < LCDMENUITEMS-1)) {
+            lcdMenuItem++;
+        } else if (pressed & BUTTON_LEFT) {
+            updateLCDState(LCD_STARTUP, currentTime);
+        } else if (pressed & BUTTON_SELECT) {
+            switch (lcdMenuItem) {
+                case 1: lcdNodeIndex = 0; break; // Port/ID Names
+                case 2: updateLCDState(LCD_ENDSTATE, currentTime); break;
+                default: updateLCDState(LCD_STARTUP, currentTime); break;
+            }
+        }
+    }
+
+    if (lcdState != LCD_MENU) {
+        return;
+    } else if (lcdNodeIndex < MAXNODES) {
+        lcdNodeScreen();
+    } else {
+        lcdMenuScreen();
+    }
+}
+
+void handleLCDState(unsigned long currentTime) {
+    static uint8_t lastButtons = 0;
+    uint8_t pressed = lcdButtons & ~lastButtons; // newly pressed only
+
+    lastButtons = lcdButtons;
+
+    switch (lcdState) {
+
+        case LCD_STARTUP:
+            lcdBacklight(true);
+            lcdSplashScreen();
+            if (pressed & BUTTON_SELECT) {
+                lcdMenuItem = 0;
+                lcdNodeIndex = MAXNODES;
+                updateLCDState(LCD_MENU, currentTime);
+            } else if (currentTime > (lastLCDStateChange + LCDSPLASHTIME)) {
+                updateLCDState(LCD_ACTIVEWAIT, currentTime);
+            } // else keep showing splash
+            break;
+
+        case LCD_ACTIVEWAIT:
+            lcdBacklight(true);
+            lcdMonitorScreen(currentTime);
+            if (actionState != VAC_LISTENING) {
+                updateLCDState(LCD_RUNNING, currentTime);
+            } else if (pressed & BUTTON_SELECT) {
+                updateLCDState(LCD_STARTUP, currentTime); // "> Menu <"
+            } else if (currentTime > (lastButtonChange + LCDSLEEPTIME)) {
+                updateLCDState(LCD_SLEEPWAIT, currentTime);
+            } // else keep monitoring
+            break;
+
+        case LCD_SLEEPWAIT:
+            // screen isn't redrawn while dark, saves the I2C bus
+            lcdBacklight(false);
+            if ((pressed != 0) || (actionState != VAC_LISTENING)) {
+                updateLCDState(LCD_ENDSTATE, currentTime);
+            }
+            break;
 
+        case LCD_MENU:
+            lcdBacklight(true);
+            handleLCDMenu(pressed, currentTime);
+            if (currentTime > (lastButtonChange + LCDSLEEPTIME)) {
+                updateLCDState(LCD_ENDSTATE, currentTime); // abandoned
+            }
+            break;
+
+        case LCD_RUNNING:
+            lcdBacklight(true);
+            lcdRunningScreen(currentTime);
+            if (actionState == VAC_LISTENING) {
+                updateLCDState(LCD_ENDSTATE, currentTime);
+            } else if (pressed & BUTTON_SELECT) {
+                updateLCDState(LCD_STARTUP, currentTime);
+            }
+            break;
+
+        case LCD_ENDSTATE:
+        default:
+            lastButtonChange = currentTime; // stay lit for a while
+            updateLCDState(LCD_ACTIVEWAIT, currentTime);
+            break;
+    }
+    lcdFlush();
 }
 
 #endif // STATEMACHINE_H